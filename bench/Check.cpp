@@ -0,0 +1,142 @@
+// Correctness checks of the generated code and the stdlib. Every program in
+// bench/check is built with each set of flags below and run; it has to exit
+// with 0. Any other exit code is a bit mask of the checks that failed, so
+// unlike the runtime benchmark's checksums these compare actual values.
+// Programs in bench/check/reject have to fail to compile instead, with the
+// message their first line names after "// error: ".
+//
+//   glang_check [--glang PATH] [--nasm NASM] [PROGRAM...]
+//
+// The -mavx2 builds need a CPU with AVX2.
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+
+#include "Toolchain.hpp"
+
+const std::string FLAGS[] = {
+    "",
+    "-O",
+    "-mavx2",
+    "-O -mavx2",
+    "-fomit-frame-pointer",
+};
+
+static int run(const std::string& directory, const std::string& program) {
+    const int status = std::system(("cd " + directory + " && ./" + program + ".out > /dev/null").c_str());
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static std::string readFirstLine(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Compiles a program that must be rejected; true if glang fails with the
+// expected message.
+static bool rejects(const Tools& tools, const std::string& directory, const std::string& program, const std::string& flags) {
+    const std::string log = program + ".log";
+    if(std::system(("cd " + directory + " && " + tools.glang + " " + program + ".glang " + flags + " > " + log + " 2>&1").c_str()) == 0) {
+        return false;
+    }
+    const std::string prefix = "// error: ";
+    const std::string expected = readFirstLine(std::filesystem::path(directory) / (program + ".glang")).substr(prefix.size());
+    std::ifstream output(std::filesystem::path(directory) / log);
+    const std::string text((std::istreambuf_iterator<char>(output)), std::istreambuf_iterator<char>());
+    return text.find(expected) != std::string::npos;
+}
+
+static std::vector<std::string> collect(const std::filesystem::path& sources, const std::vector<std::string>& selected) {
+    std::vector<std::string> programs;
+    for(const auto& entry : std::filesystem::directory_iterator(sources)) {
+        const std::filesystem::path path = entry.path();
+        if(path.extension() != ".glang") continue;
+        const std::string name = path.stem();
+        if(!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end()) continue;
+        programs.push_back(name);
+    }
+    std::sort(programs.begin(), programs.end());
+    return programs;
+}
+
+int main(int argc, char** argv) {
+    Tools tools;
+    tools.glang = std::filesystem::read_symlink("/proc/self/exe").parent_path() / "glang";
+    std::vector<std::string> selected;
+    for(int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        if(option.starts_with("--") && i + 1 >= argc) {
+            std::cerr << "missing value for " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        if(option == "--glang") tools.glang = std::filesystem::absolute(argv[++i]);
+        else if(option == "--nasm") tools.nasm = argv[++i];
+        else if(option.starts_with("--")) {
+            std::cerr << "unknown option: " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        else selected.push_back(option);
+    }
+
+    const std::filesystem::path sources = std::filesystem::path(GLANG_SOURCE_DIR) / "bench" / "check";
+    const std::vector<std::string> programs = collect(sources, selected);
+    const std::vector<std::string> rejected = collect(sources / "reject", selected);
+
+    char directory[] = "/tmp/glang_check_XXXXXX";
+    if(mkdtemp(directory) == nullptr) {
+        std::cerr << "can't create a temporary directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bool failed = false;
+    for(size_t f = 0; f < std::size(FLAGS); f++) {
+        const std::string& flags = FLAGS[f];
+        const std::string name = flags.empty() ? "default" : flags;
+        const std::string buildDirectory = std::string(directory) + "/" + std::to_string(f);
+        std::filesystem::create_directories(buildDirectory);
+        std::filesystem::copy(sources, buildDirectory);
+        for(const std::string& program : rejected) {
+            std::filesystem::copy(sources / "reject" / (program + ".glang"), buildDirectory, std::filesystem::copy_options::overwrite_existing);
+        }
+        if(!buildStdlib(tools, buildDirectory, flags)) {
+            std::cerr << name << ": can't build the stdlib, see " << buildDirectory << "/build.log" << std::endl;
+            failed = true;
+            continue;
+        }
+
+        for(const std::string& program : programs) {
+            if(!buildGlang(tools, buildDirectory, program, flags)) {
+                std::cout << program << " (" << name << "): build failed, see " << buildDirectory << "/build.log" << std::endl;
+                failed = true;
+                continue;
+            }
+            const int code = run(buildDirectory, program);
+            if(code == 0) {
+                std::cout << program << " (" << name << "): ok" << std::endl;
+            } else {
+                std::cout << program << " (" << name << "): failed checks " << code << std::endl;
+                failed = true;
+            }
+        }
+        for(const std::string& program : rejected) {
+            if(rejects(tools, buildDirectory, program, flags)) {
+                std::cout << program << " (" << name << "): rejected" << std::endl;
+            } else {
+                std::cout << program << " (" << name << "): not rejected as expected, see " << buildDirectory << "/" << program << ".log" << std::endl;
+                failed = true;
+            }
+        }
+    }
+
+    if(!failed) std::filesystem::remove_all(directory);
+    return failed ? EXIT_FAILURE : 0;
+}
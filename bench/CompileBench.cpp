@@ -0,0 +1,188 @@
+// Compile throughput of the lexer, parser, type checker and code generator
+// on synthetic programs. Prints one JSON object per configuration.
+//
+//   glang_bench [--functions N] [--depth N] [--nesting N] [--strings N]
+//               [--imports N] [--repeat N]
+//
+// Without any configuration option a fixed matrix is run that varies one
+// parameter at a time.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "AST.hpp"
+#include "Lexer.hpp"
+#include "Parser.hpp"
+#include "ProgramGenerator.hpp"
+
+struct Result {
+    size_t tokens = 0;
+    size_t nodes = 0;
+    size_t functions = 0;
+    double lexSeconds = 0;
+    double parseSeconds = 0;
+    double typeCheckSeconds = 0;
+    double codeGenSeconds = 0;
+};
+
+static size_t countNodes(Expression* expr);
+
+static size_t countNodes(Statement* statement) {
+    if(statement == nullptr) return 0;
+    size_t n = 1;
+    if(auto* stmt = dynamic_cast<Compound*>(statement)) {
+        for(Statement* child : stmt->statements) n += countNodes(child);
+    } else if(auto* stmt = dynamic_cast<If*>(statement)) {
+        n += countNodes(stmt->condition) + countNodes(stmt->body);
+    } else if(auto* stmt = dynamic_cast<IfElse*>(statement)) {
+        n += countNodes(stmt->condition) + countNodes(stmt->ifBody) + countNodes(stmt->elseBody);
+    } else if(auto* stmt = dynamic_cast<While*>(statement)) {
+        n += countNodes(stmt->condition) + countNodes(stmt->body);
+    } else if(auto* stmt = dynamic_cast<Return*>(statement)) {
+        n += countNodes(stmt->value);
+    } else if(auto* stmt = dynamic_cast<CallStatement*>(statement)) {
+        for(Expression* arg : stmt->arguments) n += countNodes(arg);
+    } else if(auto* stmt = dynamic_cast<VarAssignment*>(statement)) {
+        n += countNodes(stmt->lhs) + countNodes(stmt->rhs);
+    } else if(auto* stmt = dynamic_cast<VarDeclAssign*>(statement)) {
+        n += countNodes(stmt->value);
+    }
+    return n;
+}
+
+static size_t countNodes(Expression* expr) {
+    if(expr == nullptr) return 0;
+    size_t n = 1;
+    if(auto* id = dynamic_cast<IdExpression*>(expr)) {
+        n += countNodes(id->index);
+    } else if(auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        n += countNodes(binary->left) + countNodes(binary->right);
+    } else if(auto* call = dynamic_cast<CallExpression*>(expr)) {
+        for(Expression* arg : call->args) n += countNodes(arg);
+    }
+    return n;
+}
+
+static double seconds(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One full pipeline run; imported modules are lexed and parsed as part of
+// the parse phase, like in the compiler.
+static Result compile(const std::string& source, const std::string& path) {
+    Result result;
+
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer;
+    std::istringstream in(source);
+    std::string line;
+    unsigned int number = 1;
+    while(std::getline(in, line)) {
+        lexer.passLine(line, number++);
+    }
+    std::vector<Token> tokens = lexer.getTokens();
+    result.lexSeconds = seconds(start);
+    result.tokens = tokens.size();
+
+    start = std::chrono::steady_clock::now();
+    Parser parser(tokens, path, false);
+    Program* program = parser.parse();
+    result.parseSeconds = seconds(start);
+    for(FunctionDefinition* def : program->functions) result.nodes += 1 + countNodes(def->body);
+    for(const auto& [name, def] : program->externFunctions) result.nodes += 1 + countNodes(def->body);
+    result.functions = program->functions.size();
+
+    start = std::chrono::steady_clock::now();
+    TypeChecker typeChecker;
+    program->accept(&typeChecker);
+    result.typeCheckSeconds = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    CodeGenVisitor visitor;
+    program->accept(&visitor);
+    result.codeGenSeconds = seconds(start);
+    return result;
+}
+
+static void run(const GeneratorConfig& config, const int repeat, const std::string& directory, const bool last) {
+    ProgramGenerator generator(config);
+    const std::string source = generator.program(directory);
+
+    // best of repeat runs for every phase
+    Result best;
+    for(int i = 0; i < repeat; i++) {
+        const Result r = compile(source, directory + "/bench_main.glang");
+        if(i == 0) {
+            best = r;
+            continue;
+        }
+        best.lexSeconds = std::min(best.lexSeconds, r.lexSeconds);
+        best.parseSeconds = std::min(best.parseSeconds, r.parseSeconds);
+        best.typeCheckSeconds = std::min(best.typeCheckSeconds, r.typeCheckSeconds);
+        best.codeGenSeconds = std::min(best.codeGenSeconds, r.codeGenSeconds);
+    }
+
+    std::cout << "  {\"config\": {\"functions\": " << config.functions << ", \"expression_depth\": " << config.expressionDepth
+              << ", \"nesting\": " << config.nesting << ", \"strings\": " << config.strings << ", \"imports\": " << config.imports << "},\n"
+              << "   \"tokens\": " << best.tokens << ", \"nodes\": " << best.nodes << ", \"functions\": " << best.functions << ",\n"
+              << "   \"lexer_tokens_per_sec\": " << static_cast<long long>(best.tokens / best.lexSeconds)
+              << ", \"parser_nodes_per_sec\": " << static_cast<long long>(best.nodes / best.parseSeconds)
+              << ", \"typechecker_functions_per_sec\": " << static_cast<long long>(best.functions / best.typeCheckSeconds)
+              << ", \"codegen_functions_per_sec\": " << static_cast<long long>(best.functions / best.codeGenSeconds) << "}"
+              << (last ? "" : ",") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    GeneratorConfig config;
+    bool custom = false;
+    int repeat = 5;
+    for(int i = 1; i + 1 < argc; i += 2) {
+        const std::string option = argv[i];
+        const int value = std::atoi(argv[i + 1]);
+        if(option == "--functions") config.functions = value;
+        else if(option == "--depth") config.expressionDepth = value;
+        else if(option == "--nesting") config.nesting = value;
+        else if(option == "--strings") config.strings = value;
+        else if(option == "--imports") config.imports = value;
+        else if(option == "--repeat") repeat = std::max(1, value);
+        else {
+            std::cerr << "unknown option: " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        if(option != "--repeat") custom = true;
+    }
+
+    char directory[] = "/tmp/glang_bench_XXXXXX";
+    if(mkdtemp(directory) == nullptr) {
+        std::cerr << "can't create a temporary directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<GeneratorConfig> configs;
+    if(custom) {
+        configs.push_back(config);
+    } else {
+        configs.push_back(config);
+        configs.push_back({1000, config.expressionDepth, config.nesting, config.strings, config.imports});
+        for(int depth : {2, 8}) configs.push_back({config.functions, depth, config.nesting, config.strings, config.imports});
+        for(int nesting : {0, 6}) configs.push_back({config.functions, config.expressionDepth, nesting, config.strings, config.imports});
+        for(int strings : {0, 32}) configs.push_back({config.functions, config.expressionDepth, config.nesting, strings, config.imports});
+        for(int imports : {4, 16}) configs.push_back({config.functions, config.expressionDepth, config.nesting, config.strings, imports});
+    }
+
+    std::cout << "[" << std::endl;
+    for(size_t i = 0; i < configs.size(); i++) {
+        run(configs.at(i), repeat, directory, i + 1 == configs.size());
+    }
+    std::cout << "]" << std::endl;
+
+    std::system(("rm -rf " + std::string(directory)).c_str());
+    return 0;
+}
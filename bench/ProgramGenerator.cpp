@@ -0,0 +1,89 @@
+#include "ProgramGenerator.hpp"
+
+#include <fstream>
+
+const char* OPERATORS[] = {"+", "-", "*", "&", "|"};
+const char* COMPARISONS[] = {"<", ">", "==", "!="};
+
+ProgramGenerator::ProgramGenerator(const GeneratorConfig& config, const unsigned seed) : random(seed) {
+    this->config = config;
+}
+
+std::string ProgramGenerator::module(const std::string& prefix) {
+    std::string out;
+    // strings go to a sink instead of puts, so the modules compile without core
+    out.append("fn " + prefix + "sink(s: char*) -> i64 {\n    return 0;\n}\n\n");
+    for(int i = 0; i < config.functions; i++) {
+        function(out, prefix, i);
+    }
+    return out;
+}
+
+std::string ProgramGenerator::program(const std::string& directory) {
+    std::string out;
+    for(int i = 0; i < config.imports; i++) {
+        const std::string path = directory + "/bench_module" + std::to_string(i) + ".glang";
+        std::ofstream(path) << module("m" + std::to_string(i) + "_");
+        out.append("import(\"" + path + "\");\n");
+    }
+    out.append("\n");
+    out.append(module(""));
+
+    out.append("fn main(argc: i64, argv: char**) -> i32 {\n    let r: i64 = 0;\n");
+    for(int i = 0; i < config.imports; i++) {
+        out.append("    r = r + m" + std::to_string(i) + "_f" + std::to_string(config.functions - 1) + "(argc, r);\n");
+    }
+    out.append("    r = r + f" + std::to_string(config.functions - 1) + "(argc, r);\n");
+    out.append("    return 0;\n}\n");
+    return out;
+}
+
+void ProgramGenerator::function(std::string& out, const std::string& prefix, const int index) {
+    this->prefix = prefix;
+    current = index;
+    locals = 0;
+
+    out.append("fn " + prefix + "f" + std::to_string(index) + "(a: i64, b: i64) -> i64 {\n");
+    out.append("    let x: i64 = " + expression(config.expressionDepth) + ";\n");
+    for(int i = 0; i < config.strings; i++) {
+        out.append("    " + prefix + "sink(\"" + prefix + "f" + std::to_string(index) + " message " + std::to_string(i) + "\");\n");
+    }
+    block(out, config.nesting, 1);
+    out.append("    return x;\n}\n\n");
+}
+
+// An if around a while around the next level, each with an assignment.
+void ProgramGenerator::block(std::string& out, const int depth, const int indent) {
+    if(depth == 0) return;
+    const std::string pad(indent * 4, ' ');
+    const std::string counter = "i" + std::to_string(locals++);
+
+    out.append(pad + "if(" + operand() + " " + COMPARISONS[random() % std::size(COMPARISONS)] + " " + operand() + ") {\n");
+    out.append(pad + "    x = " + expression(config.expressionDepth) + ";\n");
+    out.append(pad + "    let " + counter + ": i64 = 0;\n");
+    out.append(pad + "    while(" + counter + " < 8) {\n");
+    out.append(pad + "        x = x + " + expression(config.expressionDepth - 1) + ";\n");
+    block(out, depth - 1, indent + 2);
+    out.append(pad + "        " + counter + " = " + counter + " + 1;\n");
+    out.append(pad + "    }\n");
+    out.append(pad + "}\n");
+}
+
+// Every binary expression is parenthesized, comparisons bind tighter than
+// arithmetic in glang.
+std::string ProgramGenerator::expression(const int depth) {
+    if(depth <= 0) return operand();
+    if(current > 0 && random() % 8 == 0) {
+        const int callee = static_cast<int>(random() % current);
+        return prefix + "f" + std::to_string(callee) + "(" + expression(depth - 1) + ", " + operand() + ")";
+    }
+    return "(" + expression(depth - 1) + " " + OPERATORS[random() % std::size(OPERATORS)] + " " + expression(depth - 1) + ")";
+}
+
+std::string ProgramGenerator::operand() {
+    switch(random() % 3) {
+        case 0: return "a";
+        case 1: return "b";
+        default: return std::to_string(random() % 1000);
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef PROGRAM_GENERATOR_HPP
+#define PROGRAM_GENERATOR_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Writes large synthetic glang programs for the compile benchmark. The
+// output only has to compile, it is never run.
+struct GeneratorConfig {
+    int functions = 100;        // per module
+    int expressionDepth = 4;    // depth of the expression trees
+    int nesting = 3;            // depth of nested if/while blocks
+    int strings = 4;            // string literals per function
+    int imports = 0;            // imported modules, each with the same shape
+};
+
+class ProgramGenerator {
+public:
+    explicit ProgramGenerator(const GeneratorConfig& config, unsigned seed = 1);
+
+    // Source of one module; functions are named <prefix>f<n> and every
+    // function may call the ones before it.
+    std::string module(const std::string& prefix);
+    // Writes the imported modules into directory and returns the source of
+    // the main module importing them.
+    std::string program(const std::string& directory);
+
+private:
+    void function(std::string& out, const std::string& prefix, int index);
+    void block(std::string& out, int depth, int indent);
+    std::string expression(int depth);
+    std::string operand();
+
+    GeneratorConfig config;
+    std::mt19937 random;
+    std::string prefix;
+    int current = 0;        // index of the function being written
+    int locals = 0;         // locals declared so far in it
+};
+
+#endif
@@ -0,0 +1,274 @@
+// Runtime of glang output against the same programs written in C. Every
+// program in bench/runtime is built with glang, with and without -O, and
+// with the C compiler at -O0 and -O2, then run under cycle, instruction and
+// branch miss counters. Prints one JSON object per program and build.
+//
+//   glang_runtime_bench [--glang PATH] [--cc CC] [--nasm NASM] [--repeat N]
+//                       [--arg VALUE]... [PROGRAM...]
+//
+// Every --arg is passed on to the programs. The par_ programs take their
+// worker count from it, running them with --arg 1 and without shows how
+// they scale.
+//
+// The counters only see user space. Where perf_event_open is not permitted
+// only the wall time is reported. Programs run in their build directory,
+// which holds INPUT_SIZE bytes of input.dat for the ones that read a file.
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Toolchain.hpp"
+
+struct Build {
+    std::string name;
+    bool glang;
+    std::string flags;
+};
+
+const Build BUILDS[] = {
+    {"glang", true, ""},
+    {"glang -O", true, "-O"},
+    {"cc -O0", false, "-O0"},
+    {"cc -O2", false, "-O2"},
+};
+
+const size_t INPUT_SIZE = 32 << 20;
+
+const int COUNTERS = 3;
+const unsigned long long EVENTS[COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+struct Sample {
+    int exitCode = -1;
+    double seconds = 0;
+    bool counted = false;
+    int error = 0;
+    long long counters[COUNTERS] = {};
+};
+
+static int openCounter(const unsigned long long config, const pid_t pid, const int group) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;
+    attr.enable_on_exec = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, group, 0));
+}
+
+// Runs the binary in its directory with stdout discarded. The child waits on
+// a pipe until the counters are attached, they start counting at its exec.
+static Sample measure(const std::string& binary, const std::vector<std::string>& arguments) {
+    Sample sample;
+    int ready[2];
+    if(pipe(ready) != 0) return sample;
+
+    const std::string directory = std::filesystem::path(binary).parent_path();
+    const pid_t pid = fork();
+    if(pid == 0) {
+        close(ready[1]);
+        char go;
+        if(read(ready[0], &go, 1) != 1) _exit(127);
+        if(chdir(directory.c_str()) != 0) _exit(127);
+        const int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        std::vector<char*> argv = {const_cast<char*>(binary.c_str())};
+        for(const std::string& argument : arguments) argv.push_back(const_cast<char*>(argument.c_str()));
+        argv.push_back(nullptr);
+        execv(binary.c_str(), argv.data());
+        _exit(127);
+    }
+    close(ready[0]);
+
+    int fds[COUNTERS];
+    sample.counted = true;
+    for(int i = 0; i < COUNTERS; i++) {
+        fds[i] = openCounter(EVENTS[i], pid, i == 0 ? -1 : fds[0]);
+        if(fds[i] < 0) {
+            sample.counted = false;
+            sample.error = errno;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    write(ready[1], "x", 1);
+    close(ready[1]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    sample.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sample.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    if(sample.counted) {
+        unsigned long long values[1 + COUNTERS];
+        if(read(fds[0], values, sizeof(values)) == sizeof(values)) {
+            for(int i = 0; i < COUNTERS; i++) sample.counters[i] = static_cast<long long>(values[1 + i]);
+        } else {
+            sample.counted = false;
+        }
+    }
+    for(int fd : fds) {
+        if(fd >= 0) close(fd);
+    }
+    return sample;
+}
+
+// The same pseudo random bytes every time, so exit codes that depend on them
+// are stable.
+static bool writeInput(const std::filesystem::path& path) {
+    std::vector<char> data(INPUT_SIZE);
+    unsigned long long state = 88172645463325252ull;
+    for(char& c : data) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        c = static_cast<char>(state);
+    }
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+static bool buildProgram(const Tools& tools, const std::string& directory, const Build& build, const std::string& program) {
+    if(!build.glang) {
+        return shell(directory, tools.cc + " " + build.flags + " -pthread -o " + program + ".out " + program + ".c");
+    }
+    return buildGlang(tools, directory, program, build.flags);
+}
+
+static std::string counter(const Sample& sample, const int i) {
+    return sample.counted ? std::to_string(sample.counters[i]) : "null";
+}
+
+int main(int argc, char** argv) {
+    Tools tools;
+    tools.glang = std::filesystem::read_symlink("/proc/self/exe").parent_path() / "glang";
+    int repeat = 5;
+    std::vector<std::string> arguments;
+    std::vector<std::string> selected;
+    for(int i = 1; i < argc; i++) {
+        const std::string option = argv[i];
+        if(option.starts_with("--") && i + 1 >= argc) {
+            std::cerr << "missing value for " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        if(option == "--glang") tools.glang = std::filesystem::absolute(argv[++i]);
+        else if(option == "--cc") tools.cc = argv[++i];
+        else if(option == "--nasm") tools.nasm = argv[++i];
+        else if(option == "--repeat") repeat = std::max(1, std::atoi(argv[++i]));
+        else if(option == "--arg") arguments.emplace_back(argv[++i]);
+        else if(option.starts_with("--")) {
+            std::cerr << "unknown option: " << option << std::endl;
+            return EXIT_FAILURE;
+        }
+        else selected.push_back(option);
+    }
+
+    const std::filesystem::path sources = std::filesystem::path(GLANG_SOURCE_DIR) / "bench" / "runtime";
+    std::vector<std::string> programs;
+    for(const auto& entry : std::filesystem::directory_iterator(sources)) {
+        const std::filesystem::path path = entry.path();
+        if(path.extension() != ".glang") continue;
+        const std::string name = path.stem();
+        if(!selected.empty() && std::find(selected.begin(), selected.end(), name) == selected.end()) continue;
+        programs.push_back(name);
+    }
+    std::sort(programs.begin(), programs.end());
+
+    char directory[] = "/tmp/glang_runtime_bench_XXXXXX";
+    if(mkdtemp(directory) == nullptr) {
+        std::cerr << "can't create a temporary directory" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path input = std::filesystem::path(directory) / "input.dat";
+    if(!writeInput(input)) {
+        std::cerr << "can't write " << input.string() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // one directory per build, the programs include their C helpers and
+    // import the stdlib relative to it
+    std::vector<bool> built;
+    for(const Build& build : BUILDS) {
+        const std::filesystem::path buildDirectory = std::filesystem::path(directory) / std::to_string(built.size());
+        std::filesystem::create_directories(buildDirectory);
+        std::filesystem::copy(sources, buildDirectory);
+        std::filesystem::create_hard_link(input, buildDirectory / "input.dat");
+        built.push_back(!build.glang || buildStdlib(tools, buildDirectory, build.flags));
+        if(!built.back()) std::cerr << build.name << ": can't build the stdlib, see " << buildDirectory.string() << "/build.log" << std::endl;
+    }
+
+    bool warned = false;
+    bool failed = false;
+    std::cout << "[" << std::endl;
+    for(size_t p = 0; p < programs.size(); p++) {
+        const std::string& program = programs.at(p);
+        int expected = -1;
+        for(size_t b = 0; b < std::size(BUILDS); b++) {
+            const Build& build = BUILDS[b];
+            const std::string buildDirectory = std::string(directory) + "/" + std::to_string(b);
+            const bool last = p + 1 == programs.size() && b + 1 == std::size(BUILDS);
+            const std::string entry = "  {\"program\": \"" + program + "\", \"build\": \"" + build.name + "\", ";
+
+            if(!built.at(b) || !buildProgram(tools, buildDirectory, build, program)) {
+                std::cerr << program << " (" << build.name << "): build failed, see " << buildDirectory << "/build.log" << std::endl;
+                std::cout << entry << "\"error\": \"build failed\"}" << (last ? "" : ",") << std::endl;
+                failed = true;
+                continue;
+            }
+
+            // best of repeat runs for every counter
+            Sample best;
+            for(int i = 0; i < repeat; i++) {
+                const Sample s = measure(buildDirectory + "/" + program + ".out", arguments);
+                if(i == 0) {
+                    best = s;
+                    continue;
+                }
+                best.seconds = std::min(best.seconds, s.seconds);
+                for(int c = 0; c < COUNTERS; c++) best.counters[c] = std::min(best.counters[c], s.counters[c]);
+                best.counted = best.counted && s.counted;
+                if(!s.counted) best.error = s.error;
+            }
+            if(!best.counted && !warned) {
+                std::cerr << "perf_event_open: " << std::strerror(best.error) << ", only reporting wall time" << std::endl;
+                warned = true;
+            }
+
+            // every build has to compute the same result
+            if(expected == -1) expected = best.exitCode;
+            if(best.exitCode != expected) {
+                std::cerr << program << " (" << build.name << "): exit code " << best.exitCode << ", expected " << expected << std::endl;
+                failed = true;
+            }
+
+            std::cout << entry << "\"exit_code\": " << best.exitCode << ", \"seconds\": " << best.seconds
+                      << ", \"cycles\": " << counter(best, 0) << ", \"instructions\": " << counter(best, 1)
+                      << ", \"branch_misses\": " << counter(best, 2) << "}" << (last ? "" : ",") << std::endl;
+        }
+    }
+    std::cout << "]" << std::endl;
+
+    if(!failed) std::filesystem::remove_all(directory);
+    return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,34 @@
+#include "Toolchain.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+
+const char* const STDLIB_MODULES[] = {"linux", "core", "malloc", "arena", "reader", "file", "uring", "thread", "parallel"};
+
+bool shell(const std::string& directory, const std::string& command) {
+    return std::system(("cd " + directory + " && " + command + " >> build.log 2>&1").c_str()) == 0;
+}
+
+bool buildStdlib(const Tools& tools, const std::string& directory, const std::string& flags) {
+    const std::filesystem::path stdlib = std::filesystem::path(directory) / "stdlib";
+    std::filesystem::create_directories(stdlib);
+    for(const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(GLANG_SOURCE_DIR) / "stdlib")) {
+        if(entry.path().extension() == ".glang") {
+            std::filesystem::copy(entry.path(), stdlib, std::filesystem::copy_options::overwrite_existing);
+        }
+    }
+
+    std::string objects;
+    for(const std::string module : STDLIB_MODULES) {
+        if(!shell(directory, tools.glang + " stdlib/" + module + ".glang -L --no-core " + flags)) return false;
+        if(!shell(directory, tools.nasm + " -felf64 stdlib/" + module + ".asm -o stdlib/" + module + ".o")) return false;
+        objects += " stdlib/" + module + ".o";
+    }
+    return shell(directory, "ar rcs stdlib/libglang.a" + objects);
+}
+
+bool buildGlang(const Tools& tools, const std::string& directory, const std::string& program, const std::string& flags) {
+    return shell(directory, tools.glang + " " + program + ".glang " + flags)
+        && shell(directory, tools.nasm + " -felf64 " + program + ".asm -o " + program + ".o")
+        && shell(directory, "ld -Lstdlib " + program + ".o -lglang -o " + program + ".out");
+}
@@ -0,0 +1,24 @@
+#ifndef TOOLCHAIN_HPP
+#define TOOLCHAIN_HPP
+
+#include <string>
+
+// Builds glang programs against a copy of the stdlib for the runtime
+// benchmark and the checks. Commands run in a build directory and append
+// their output to its build.log.
+struct Tools {
+    std::string glang;
+    std::string cc = "cc";
+    std::string nasm = "nasm";
+};
+
+bool shell(const std::string& directory, const std::string& command);
+
+// Copies the stdlib sources into directory/stdlib and builds libglang.a
+// from them with the given compiler flags.
+bool buildStdlib(const Tools& tools, const std::string& directory, const std::string& flags);
+
+// Builds directory/program.glang into program.out.
+bool buildGlang(const Tools& tools, const std::string& directory, const std::string& program, const std::string& flags);
+
+#endif
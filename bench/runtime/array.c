@@ -0,0 +1,14 @@
+#include "core.h"
+
+static unsigned long values[8192];
+
+int main(void) {
+    for(unsigned long i = 0; i < 8192; i++) values[i] = i % 7;
+
+    unsigned long total = 0;
+    for(unsigned long n = 0; n < 2000; n++) {
+        barrier();
+        for(unsigned long i = 0; i < 8192; i++) total = total + values[i];
+    }
+    return total % 256;
+}
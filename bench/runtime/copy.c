@@ -0,0 +1,29 @@
+#include "core.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(void) {
+    const unsigned long block = 65536;
+    int in = open("input.dat", O_RDONLY);
+    int out = open("output.dat", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(in < 0 || out < 0) return 255;
+    char* buf = malloc(block);
+
+    unsigned long total = 0;
+    long n = read(in, buf, block);
+    while(n > 0) {
+        total += (unsigned char) buf[0];
+        long done = 0;
+        while(done < n) {
+            long written = write(out, buf + done, n - done);
+            if(written <= 0) return 255;
+            done += written;
+        }
+        n = read(in, buf, block);
+    }
+    close(in);
+    close(out);
+    return total % 256;
+}
@@ -0,0 +1,113 @@
+// C versions of the stdlib/core.glang functions the runtime benchmarks use.
+// They follow the glang code statement by statement so both sides run the
+// same algorithm and produce the same exit code.
+
+#ifndef BENCH_CORE_H
+#define BENCH_CORE_H
+
+#include <string.h>
+
+// keeps the optimizer from hoisting loop invariant calls out of the timed loop
+#define barrier() __asm__ volatile("" ::: "memory")
+
+static void reverse_string(char* str) {
+    unsigned long len = strlen(str);
+    unsigned long n = len / 2;
+    unsigned long i = 0;
+
+    while(i <= n) {
+        char c = str[i];
+        unsigned long index = len - 1 - i;
+        str[i] = str[index];
+        str[index] = c;
+        i = i + 1;
+    }
+}
+
+static unsigned long u64_digits(unsigned long x) {
+    unsigned long n = 1;
+    unsigned long p = 10;
+    while(x >= p) {
+        n = n + 1;
+        if(n == 20) return n;
+        p = p * 10;
+    }
+    return n;
+}
+
+static const char PAIRS[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static unsigned long u64_to_str(unsigned long x, char* buf) {
+    unsigned long len = u64_digits(x);
+    unsigned long i = len;
+    buf[i] = 0;
+    while(x >= 100) {
+        unsigned long q = x / 100;
+        unsigned long r = (x - q * 100) * 2;
+        i = i - 2;
+        buf[i] = PAIRS[r];
+        buf[i + 1] = PAIRS[r + 1];
+        x = q;
+    }
+    if(x >= 10) {
+        buf[0] = PAIRS[x * 2];
+        buf[1] = PAIRS[x * 2 + 1];
+    } else {
+        buf[0] = x + '0';
+    }
+    return len;
+}
+
+static unsigned long i64_to_str(long x, char* buf) {
+    if(x < 0) {
+        buf[0] = '-';
+        return u64_to_str(0 - (unsigned long) x, buf + 1) + 1;
+    }
+    return u64_to_str(x, buf);
+}
+
+static void itos(long x, char* buf) {
+    i64_to_str(x, buf);
+}
+
+static long parse_state = 0;
+
+static unsigned long str_to_u64(const char* str) {
+    const unsigned long limit = 1844674407370955161ul;
+    unsigned long x = 0;
+    unsigned long i = 0;
+    unsigned long overflow = 0;
+    unsigned long d = (unsigned char) str[0] - (unsigned long) '0';
+    while(d <= 9) {
+        if(x > limit || (x == limit && d > 5)) overflow = 1;
+        x = x * 10 + d;
+        i = i + 1;
+        d = (unsigned char) str[i] - (unsigned long) '0';
+    }
+    parse_state = 1;
+    if(i == 0 || overflow != 0 || str[i] != 0) parse_state = -1;
+    return x;
+}
+
+static long str_to_i64(const char* str) {
+    unsigned long negative = 0;
+    const char* digits = str;
+    if(str[0] == '-' || str[0] == '+') {
+        if(str[0] == '-') negative = 1;
+        digits = str + 1;
+    }
+    unsigned long magnitude = str_to_u64(digits);
+    const unsigned long limit = 1ul << 63;
+    if(magnitude > limit || (magnitude == limit && negative == 0)) parse_state = -1;
+    if(negative != 0) return (long) (0 - magnitude);
+    return (long) magnitude;
+}
+
+static long stoi(const char* str) {
+    return str_to_i64(str);
+}
+
+#endif
@@ -0,0 +1,8 @@
+unsigned long fib(unsigned long n) {
+    if(n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+    return fib(30) % 256;
+}
@@ -0,0 +1,12 @@
+#include "core.h"
+
+static char buf[32];
+
+int main(void) {
+    unsigned long total = 0;
+    for(long i = 1; i < 2000000; i++) {
+        itos(i, buf);
+        total += (unsigned char) buf[0];
+    }
+    return total % 256;
+}
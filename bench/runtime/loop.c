@@ -0,0 +1,7 @@
+int main(void) {
+    unsigned long total = 0;
+    for(unsigned long i = 0; i < 20000000; i++) {
+        total = total + ((i * i) % 7);
+    }
+    return total % 256;
+}
@@ -0,0 +1,29 @@
+#include <stdlib.h>
+
+static unsigned char* slots[1024];
+static unsigned long sizes[1024];
+
+int main(void) {
+    unsigned long seed = 12345;
+    unsigned long total = 0;
+    for(unsigned long i = 0; i < 2000000; i++) {
+        seed = (seed * 1103515245 + 12345) % 2147483647;
+        unsigned long slot = seed % 1024;
+        unsigned char* p = slots[slot];
+        if(p != 0) {
+            unsigned long n = sizes[slot];
+            total = total + p[0] + p[n - 1];
+            free(p);
+            slots[slot] = 0;
+        } else {
+            unsigned long n = 1 + (seed / 1024) % 512;
+            if(seed % 64 == 0) n = n + 40000;
+            p = malloc(n);
+            p[0] = (slot * 8 + n) % 251;
+            p[n - 1] = (slot * 8 + n) % 241;
+            slots[slot] = p;
+            sizes[slot] = n;
+        }
+    }
+    return total % 256;
+}
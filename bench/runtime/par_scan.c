@@ -0,0 +1,76 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// par_scan.glang with one contiguous slice of the file per thread
+struct Slice {
+    const char* data;
+    unsigned long lo;
+    unsigned long hi;
+    unsigned long count;
+};
+
+static void* scan(void* arg) {
+    struct Slice* slice = arg;
+    const char* end = slice->data + slice->hi;
+    const char* p = slice->data + slice->lo;
+    unsigned long count = 0;
+    const char* hit = memchr(p, '\n', end - p);
+    while(hit != NULL) {
+        count++;
+        p = hit + 1;
+        hit = memchr(p, '\n', end - p);
+    }
+    slice->count = count;
+    return NULL;
+}
+
+static unsigned long run(struct Slice* slices, pthread_t* threads, int count) {
+    for(int t = 1; t < count; t++) pthread_create(&threads[t], NULL, scan, &slices[t]);
+    scan(&slices[0]);
+    unsigned long total = slices[0].count;
+    for(int t = 1; t < count; t++) {
+        pthread_join(threads[t], NULL);
+        total += slices[t].count;
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    int count = 1;
+    cpu_set_t cpus;
+    if(sched_getaffinity(0, sizeof(cpus), &cpus) == 0) count = CPU_COUNT(&cpus);
+    if(argc > 1) count = atoi(argv[1]);
+    if(count < 1) count = 1;
+    if(count > 64) count = 64;
+
+    int fd = open("input.dat", O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0) return 255;
+    unsigned long n = st.st_size;
+    const char* data = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) return 255;
+    madvise((void*) data, n, MADV_SEQUENTIAL);
+
+    struct Slice slices[64];
+    pthread_t threads[64];
+    for(int t = 0; t < count; t++) {
+        slices[t].data = data;
+        slices[t].lo = n * t / count;
+        slices[t].hi = n * (t + 1) / count;
+    }
+
+    unsigned long first = run(slices, threads, count);
+    for(int round = 1; round < 16; round++) {
+        if(run(slices, threads, count) != first) return 255;
+    }
+    munmap((void*) data, n);
+    return first % 256;
+}
@@ -0,0 +1,66 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+// par_sum.glang with one contiguous slice of the array per thread
+struct Slice {
+    unsigned long* values;
+    unsigned long lo;
+    unsigned long hi;
+    unsigned long total;
+};
+
+static void* fill(void* arg) {
+    struct Slice* slice = arg;
+    for(unsigned long i = slice->lo; i < slice->hi; i++) slice->values[i] = (i * 40503) % 65521;
+    return NULL;
+}
+
+static void* sum(void* arg) {
+    struct Slice* slice = arg;
+    unsigned long total = 0;
+    for(unsigned long i = slice->lo; i < slice->hi; i++) total += slice->values[i];
+    slice->total = total;
+    return NULL;
+}
+
+static unsigned long run(void* (*body)(void*), struct Slice* slices, pthread_t* threads, int count) {
+    for(int t = 1; t < count; t++) pthread_create(&threads[t], NULL, body, &slices[t]);
+    body(&slices[0]);
+    unsigned long total = slices[0].total;
+    for(int t = 1; t < count; t++) {
+        pthread_join(threads[t], NULL);
+        total += slices[t].total;
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    const unsigned long n = 4194304;
+    int count = 1;
+    cpu_set_t cpus;
+    if(sched_getaffinity(0, sizeof(cpus), &cpus) == 0) count = CPU_COUNT(&cpus);
+    if(argc > 1) count = atoi(argv[1]);
+    if(count < 1) count = 1;
+    if(count > 64) count = 64;
+
+    unsigned long* values = mmap(NULL, n * 8, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(values == MAP_FAILED) return 255;
+    struct Slice slices[64];
+    pthread_t threads[64];
+    for(int t = 0; t < count; t++) {
+        slices[t].values = values;
+        slices[t].lo = n * t / count;
+        slices[t].hi = n * (t + 1) / count;
+        slices[t].total = 0;
+    }
+    run(fill, slices, threads, count);
+
+    unsigned long first = run(sum, slices, threads, count);
+    for(int round = 1; round < 20; round++) {
+        if(run(sum, slices, threads, count) != first) return 255;
+    }
+    return first % 256;
+}
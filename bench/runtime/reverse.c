@@ -0,0 +1,13 @@
+#include "core.h"
+
+static char text[256];
+
+int main(void) {
+    for(unsigned long i = 0; i < 255; i++) text[i] = 'a' + (i % 26);
+
+    for(unsigned long n = 0; n < 200000; n++) {
+        barrier();
+        reverse_string(text);
+    }
+    return (unsigned char) text[0];
+}
@@ -0,0 +1,12 @@
+#include "core.h"
+
+static char buf[32] = "12345";
+
+int main(void) {
+    long total = 0;
+    for(unsigned long i = 0; i < 2000000; i++) {
+        barrier();
+        total += stoi(buf);
+    }
+    return total % 256;
+}
@@ -0,0 +1,14 @@
+#include "core.h"
+
+static char text[4096];
+
+int main(void) {
+    for(unsigned long i = 0; i < 4095; i++) text[i] = 'a';
+
+    unsigned long total = 0;
+    for(unsigned long n = 0; n < 200000; n++) {
+        barrier();
+        total += strlen(text);
+    }
+    return total % 256;
+}
@@ -0,0 +1,149 @@
+#include "core.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// stdlib/uring.glang on the raw system calls
+struct Ring {
+    int fd;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned long localTail;
+    struct io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe* cqes;
+};
+
+static int uring_open(struct Ring* ring, unsigned entries) {
+    struct io_uring_params params = {0};
+    ring->fd = (int) syscall(SYS_io_uring_setup, entries, &params);
+    if(ring->fd < 0) return 0;
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(cqSize > sqSize) sqSize = cqSize;
+        cqSize = sqSize;
+    }
+    char* sq = mmap(0, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    char* cq = sq;
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(0, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    }
+    ring->sqes = mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(sq == MAP_FAILED || cq == MAP_FAILED || ring->sqes == MAP_FAILED) return 0;
+
+    ring->sqHead = (unsigned*) (sq + params.sq_off.head);
+    ring->sqTail = (unsigned*) (sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sqEntries = params.sq_entries;
+    unsigned* array = (unsigned*) (sq + params.sq_off.array);
+    for(unsigned i = 0; i < params.sq_entries; i++) array[i] = i;
+    ring->localTail = *ring->sqTail;
+    ring->cqHead = (unsigned*) (cq + params.cq_off.head);
+    ring->cqTail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + params.cq_off.cqes);
+    return 1;
+}
+
+static void uring_prep(struct Ring* ring, int op, int fd, char* buf, unsigned len, unsigned long offset, unsigned long data) {
+    struct io_uring_sqe* sqe = &ring->sqes[ring->localTail & ring->sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->off = offset;
+    sqe->addr = (unsigned long) buf;
+    sqe->len = len;
+    sqe->user_data = data;
+    ring->localTail++;
+}
+
+static long uring_submit(struct Ring* ring, unsigned wait) {
+    unsigned pending = (unsigned) ring->localTail - *ring->sqTail;
+    __atomic_store_n(ring->sqTail, (unsigned) ring->localTail, __ATOMIC_RELEASE);
+    return syscall(SYS_io_uring_enter, ring->fd, pending, wait, wait ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+}
+
+static unsigned long offsets[8];
+static unsigned long lengths[8];
+
+int main(void) {
+    const unsigned long block = 65536;
+    const unsigned long depth = 8;
+    int in = open("input.dat", O_RDONLY);
+    int out = open("output.dat", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    struct Ring ring;
+    if(in < 0 || out < 0 || !uring_open(&ring, depth * 2)) return 255;
+    struct stat st;
+    fstat(in, &st);
+    unsigned long size = st.st_size;
+    char* buffers = malloc(depth * block);
+
+    unsigned long next = 0;
+    unsigned long inflight = 0;
+    for(unsigned long b = 0; b < depth && next < size; b++) {
+        unsigned long len = size - next < block ? size - next : block;
+        offsets[b] = next;
+        lengths[b] = len;
+        uring_prep(&ring, IORING_OP_READ, in, buffers + b * block, len, next, b * 2);
+        next += len;
+        inflight++;
+    }
+
+    unsigned long total = 0;
+    unsigned long copied = 0;
+    while(inflight > 0) {
+        if(uring_submit(&ring, 1) < 0) return 255;
+        unsigned head = *ring.cqHead;
+        while(head != __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe* cqe = &ring.cqes[head & ring.cqMask];
+            unsigned long data = cqe->user_data;
+            long result = cqe->res;
+            __atomic_store_n(ring.cqHead, ++head, __ATOMIC_RELEASE);
+            inflight--;
+            unsigned long b = data / 2;
+            char* buf = buffers + b * block;
+            if(result != (long) lengths[b]) return 255;
+
+            if(data % 2 == 0) {
+                total += (unsigned char) buf[0];
+                uring_prep(&ring, IORING_OP_WRITE, out, buf, result, offsets[b], data + 1);
+                inflight++;
+            } else {
+                copied += result;
+                if(next < size) {
+                    unsigned long len = size - next < block ? size - next : block;
+                    offsets[b] = next;
+                    lengths[b] = len;
+                    uring_prep(&ring, IORING_OP_READ, in, buf, len, next, b * 2);
+                    next += len;
+                    inflight++;
+                }
+            }
+        }
+    }
+
+    uring_prep(&ring, IORING_OP_READ, out, buffers, block, 0, 0);
+    if(uring_submit(&ring, 1) < 0) return 255;
+    unsigned head = *ring.cqHead;
+    if(head == __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE)) return 255;
+    if(ring.cqes[head & ring.cqMask].res != -EBADF) return 255;
+    __atomic_store_n(ring.cqHead, head + 1, __ATOMIC_RELEASE);
+
+    close(ring.fd);
+    close(in);
+    close(out);
+    if(copied != size) return 255;
+    return total % 256;
+}
@@ -1,24 +1,61 @@
 #!/usr/bin/env bash
 
 # Build the project
+# Every function gets its own section so the linker can drop unused ones;
+# set GC_SECTIONS=0 to keep everything.
+GC_SECTIONS="${GC_SECTIONS:-1}"
+GLANGFLAGS=""
+LDFLAGS=""
+if [ "$GC_SECTIONS" = "1" ]; then
+    GLANGFLAGS="-ffunction-sections"
+    LDFLAGS="--gc-sections"
+fi
 
 echo "Building stdlib..."
 echo "Compiling linux.glang..."
-./cmake-build-debug/glang ./stdlib/linux.glang -L --no-core
+./cmake-build-debug/glang ./stdlib/linux.glang -L --no-core $GLANGFLAGS
 echo "Assembling linux.asm..."
 nasm -felf64 -g -Fdwarf ./stdlib/linux.asm -o ./stdlib/linux.o
 echo "Compiling core.glang..."
-./cmake-build-debug/glang ./stdlib/core.glang -L --no-core
+./cmake-build-debug/glang ./stdlib/core.glang -L --no-core $GLANGFLAGS
 echo "Assembling core.asm..."
 nasm -felf64 -g -Fdwarf ./stdlib/core.asm -o ./stdlib/core.o
+echo "Compiling malloc.glang..."
+./cmake-build-debug/glang ./stdlib/malloc.glang -L --no-core $GLANGFLAGS
+echo "Assembling malloc.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/malloc.asm -o ./stdlib/malloc.o
+echo "Compiling arena.glang..."
+./cmake-build-debug/glang ./stdlib/arena.glang -L --no-core $GLANGFLAGS
+echo "Assembling arena.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/arena.asm -o ./stdlib/arena.o
+echo "Compiling reader.glang..."
+./cmake-build-debug/glang ./stdlib/reader.glang -L --no-core $GLANGFLAGS
+echo "Assembling reader.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/reader.asm -o ./stdlib/reader.o
+echo "Compiling file.glang..."
+./cmake-build-debug/glang ./stdlib/file.glang -L --no-core $GLANGFLAGS
+echo "Assembling file.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/file.asm -o ./stdlib/file.o
+echo "Compiling uring.glang..."
+./cmake-build-debug/glang ./stdlib/uring.glang -L --no-core $GLANGFLAGS
+echo "Assembling uring.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/uring.asm -o ./stdlib/uring.o
+echo "Compiling thread.glang..."
+./cmake-build-debug/glang ./stdlib/thread.glang -L --no-core $GLANGFLAGS
+echo "Assembling thread.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/thread.asm -o ./stdlib/thread.o
+echo "Compiling parallel.glang..."
+./cmake-build-debug/glang ./stdlib/parallel.glang -L --no-core $GLANGFLAGS
+echo "Assembling parallel.asm..."
+nasm -felf64 -g -Fdwarf ./stdlib/parallel.asm -o ./stdlib/parallel.o
 echo "Creating libglang.a..."
-ar rcs ./stdlib/libglang.a ./stdlib/linux.o ./stdlib/core.o
+ar rcs ./stdlib/libglang.a ./stdlib/linux.o ./stdlib/core.o ./stdlib/malloc.o ./stdlib/arena.o ./stdlib/reader.o ./stdlib/file.o ./stdlib/uring.o ./stdlib/thread.o ./stdlib/parallel.o
 
 echo ""
 echo "Building test..."
 echo "Compiling test.glang..."
-./cmake-build-debug/glang ./examples/test.glang
+./cmake-build-debug/glang ./examples/test.glang $GLANGFLAGS
 echo "Assembling test.asm..."
 nasm -felf64 -g -Fdwarf ./examples/test.asm -o ./examples/test.o
 echo "Linking test.out..."
-ld -g -Lstdlib examples/test.o -lglang -o ./examples/test.out
\ No newline at end of file
+ld -g $LDFLAGS -Lstdlib examples/test.o -lglang -o ./examples/test.out
\ No newline at end of file
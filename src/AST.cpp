@@ -1,7 +1,16 @@
 #include "AST.hpp"
+#include "CallGraph.hpp"
+#include "FrameLayout.hpp"
+#include "InstructionSelector.hpp"
+#include "Intrinsics.hpp"
+#include "IR.hpp"
 #include "OpCode.hpp"
+#include "Passes.hpp"
 #include "ScratchAllocator.h"
+#include "Switch.hpp"
+#include "Vectorizer.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <cstdlib>
@@ -28,7 +37,75 @@ const std::string GPREGS32[] =  {"ebx", "r10d", "r11d", "r12d", "r13d", "r14d",
 
 const int FIRST_ARG = 7;
 
-std::array<bool, 7> usedRegs = {false, false, false, false, false, false, false};
+// bytes below rsp that signal handlers leave alone (System V ABI)
+const int RED_ZONE = 128;
+
+// registers a call may clobber, as GPREGS indices
+const int CALL_CLOBBERED[] = {1, 2, 7, 8, 9, 10, 11, 12, 13};
+const int SYSCALL_CLOBBERED[] = {2, 7, 11};
+// syscall argument (counting the number) that is passed in r10 instead of rcx
+const int SYSCALL_R10_ARG = 4;
+
+static bool isLogic(const BinaryOperator op) {
+    return op == BinaryOperator::LOGIC_AND || op == BinaryOperator::LOGIC_OR;
+}
+
+static bool isComparison(const BinaryOperator op) {
+    switch(op) {
+        case BinaryOperator::EQUALS:
+        case BinaryOperator::NEQUALS:
+        case BinaryOperator::LESS:
+        case BinaryOperator::GREATER:
+        case BinaryOperator::LEQUALS:
+        case BinaryOperator::GEQUALS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Condition code for jumping if the comparison holds, or if it doesn't with negate.
+static std::string conditionCode(const BinaryOperator op, const bool sign, const bool negate) {
+    switch(op) {
+        case BinaryOperator::EQUALS:   return negate ? "ne" : "e";
+        case BinaryOperator::NEQUALS:  return negate ? "e" : "ne";
+        case BinaryOperator::LESS:     return negate ? (sign ? "ge" : "ae") : (sign ? "l" : "b");
+        case BinaryOperator::GREATER:  return negate ? (sign ? "le" : "be") : (sign ? "g" : "a");
+        case BinaryOperator::LEQUALS:  return negate ? (sign ? "g" : "a") : (sign ? "le" : "be");
+        case BinaryOperator::GEQUALS:  return negate ? (sign ? "l" : "b") : (sign ? "ge" : "ae");
+        default: throw std::runtime_error("not a comparison operator");
+    }
+}
+
+// A comparison is signed if both sides are; literals take the signedness of
+// the other side, like in IRBuilder.
+static bool comparesSigned(const BinaryExpression* expr) {
+    auto literal = [](Expression* side) {
+        return dynamic_cast<IntLit*>(side) != nullptr || dynamic_cast<CharLit*>(side) != nullptr;
+    };
+    return (literal(expr->left) || typeSigned(expr->left->type)) && (literal(expr->right) || typeSigned(expr->right->type));
+}
+
+static std::string sizedReg(const int reg, const int width) {
+    switch(width) {
+        case 1: return GPREGS8[reg];
+        case 2: return GPREGS16[reg];
+        case 4: return GPREGS32[reg];
+        default: return GPREGS[reg];
+    }
+}
+
+// True if evaluating expr calls something, syscalls and builtins included.
+static bool containsCall(Expression* expr) {
+    if(dynamic_cast<CallExpression*>(expr) != nullptr) return true;
+    if(auto* id = dynamic_cast<IdExpression*>(expr)) {
+        return id->index != nullptr && containsCall(id->index);
+    }
+    if(auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        return containsCall(binary->left) || containsCall(binary->right);
+    }
+    return false;
+}
 
 void IntLit::accept(Visitor* visitor, int reg) {
     visitor->visitIntLit(this, reg);
@@ -98,6 +175,11 @@ void While::accept(Visitor* visitor)
     visitor->visitWhile(this);
 }
 
+void Switch::accept(Visitor* visitor)
+{
+    visitor->visitSwitch(this);
+}
+
 void FunctionDefinition::accept(Visitor* visitor) {
     visitor->visitFunctionDefinition(this);
 }
@@ -165,6 +247,8 @@ void ConstExprVisitor::visitBinaryExpression(BinaryExpression* expr, int reg) {
         case BinaryOperator::GEQUALS:
         case BinaryOperator::BIT_AND:
         case BinaryOperator::BIT_OR:
+        case BinaryOperator::LOGIC_AND:
+        case BinaryOperator::LOGIC_OR:
             break;
         }
 }
@@ -173,6 +257,7 @@ void ConstExprVisitor::visitCompound(Compound* stmt) {}
 void ConstExprVisitor::visitEndCompound(EndCompound* stmt) {}
 void ConstExprVisitor::visitIf(If* stmt) {}
 void ConstExprVisitor::visitIfElse(IfElse* stmt) {}
+void ConstExprVisitor::visitSwitch(Switch* stmt) {}
 
 void ConstExprVisitor::visitReturn(Return* stmt) {
     if(stack.top().has_value())
@@ -454,6 +539,21 @@ void TypeChecker::visitWhile(While* stmt)
     stmt->body->accept(this);
 }
 
+void TypeChecker::visitSwitch(Switch* stmt)
+{
+    stmt->value->accept(this, 0);
+    if (typeStack.top().ptrDepth != 0 || typeStack.top().type == TypeIdentifierType::VOID || typeStack.top().type == TypeIdentifierType::F32 || typeStack.top().type == TypeIdentifierType::F64)
+    {
+        throw std::runtime_error(stmt->path + ":" + std::to_string(stmt->lineNum) + ":" + std::to_string(stmt->colNum) + ":" + "expected integer expression in switch");
+    }
+    typeStack.pop();
+    for (const Switch::Case& c : stmt->cases)
+    {
+        c.body->accept(this);
+    }
+    if (stmt->defaultBody != nullptr) stmt->defaultBody->accept(this);
+}
+
 void TypeChecker::visitFunctionDefinition(FunctionDefinition* def)
 {
     currentFunction = def;
@@ -498,7 +598,8 @@ void CodeGenVisitor::pop(const std::string& where, const size_t bytes = 8) {
     offset -= bytes;
 }
 
-CodeGenVisitor::CodeGenVisitor() {
+CodeGenVisitor::CodeGenVisitor(const CodeGenOptions& options) {
+    this->options = options;
     root = new Scope(nullptr);
     current = root;
     allocator = ScratchAllocator();
@@ -511,10 +612,7 @@ void CodeGenVisitor::visitIntLit(IntLit* expr, const int reg) {
 }
 
 void CodeGenVisitor::visitStringLit(StringLit* expr, const int reg) {
-    auto* code = new DefineString(expr->value, stringIndex++);
-
-    dataSegment.push_back(code);
-    textSegment.push_back(new Move(GPREGS[reg], code->getId()));
+    textSegment.push_back(new Move(GPREGS[reg], strings->intern(expr->value)));
     expr->type = TypeIdentifier{TypeIdentifierType::CHAR, 1};
 }
 
@@ -532,15 +630,14 @@ void CodeGenVisitor::visitIdExpression(IdExpression* expr, const int reg) {
     TypeIdentifier type;
     std::string right;
 
+    bool array = false;
+
     if(current->getVar(expr->id) != nullptr) {
         const Var* var = current->getVar(expr->id);
-        const int off = offset - var->offset;
 
         type = var->type;
-        
-        right.append("[rsp + ");
-        right.append(std::to_string(off));
-        right.append("]");
+        array = var->array;
+        right = slot(var->offset);
     }
     else if(globalVars.contains(expr->id.name)) {
         type = globalVars.find(expr->id.name)->second;
@@ -550,22 +647,46 @@ void CodeGenVisitor::visitIdExpression(IdExpression* expr, const int reg) {
         if (!loadAddress && type.ptrDepth == 0) right.append("]");
         global = true;
     }
+    else if(functions.contains(expr->id.name) && !indexExpr && expr->derefDepth == 0) {
+        // a function named as a value is its address, e.g. for thread_spawn
+        textSegment.push_back(new Move(GPREGS[reg], expr->id.name));
+        expr->type = TypeIdentifier{TypeIdentifierType::U64, 0};
+        return;
+    }
     else {
         throw std::runtime_error("can't resolve symbol: \"" + expr->id.name + "\"");
     }
 
-    if(loadAddress && type.ptrDepth == 0) textSegment.push_back(new LoadEffectiveAddr(GPREGS[reg], right));
-    else textSegment.push_back(new Move(GPREGS[reg], right));
-
-    if(indexExpr) {
+    int indexReg = -1;
+    auto evaluateIndex = [&] {
         bool wasLoadAddress = loadAddress;
         if (loadAddress) loadAddress = false;
-
-        int indexReg = allocator.allocate();
         expr->index->accept(this, indexReg);
         if (wasLoadAddress) loadAddress = true;
+    };
+    // an index that calls something goes first so the base doesn't have to survive the call
+    if(indexExpr && containsCall(expr->index)) {
+        indexReg = allocator.allocate();
+        evaluateIndex();
+    }
+
+    // assigning to a pointer variable itself needs its slot, not its value
+    const bool pointerSlot = loadAddress && !global && !indexExpr && expr->derefDepth == 0;
+    if((loadAddress && type.ptrDepth == 0) || array || pointerSlot) textSegment.push_back(new LoadEffectiveAddr(GPREGS[reg], global ? "[" + right + "]" : right));
+    else if(global || type.ptrDepth > 0) textSegment.push_back(new Move(GPREGS[reg], right));
+    else load(reg, right, type);
+
+    if(indexExpr) {
+        if(indexReg == -1) {
+            indexReg = allocator.allocate();
+            live[reg] = true;
+            evaluateIndex();
+            live[reg] = false;
+        }
         textSegment.push_back(new Add(GPREGS[reg], GPREGS[indexReg]));
-        if(!loadAddress) textSegment.push_back(new Move(GPREGS[reg], "[" + GPREGS[reg] + "]"));
+        // elements are read at their own width so reads never reach past the end
+        if(!loadAddress && type.ptrDepth == 1) load(reg, "[" + GPREGS[reg] + "]", TypeIdentifier{type.type, 0});
+        else if(!loadAddress) textSegment.push_back(new Move(GPREGS[reg], "[" + GPREGS[reg] + "]"));
         allocator.free(indexReg);
 
     }
@@ -597,7 +718,7 @@ void CodeGenVisitor::visitIdExpression(IdExpression* expr, const int reg) {
 
     deref(expr->derefDepth, type.ptrDepth, newReg, GPREGS[reg]);
 
-    if (expr->derefDepth == type.ptrDepth)
+    if (expr->derefDepth == type.ptrDepth && !loadAddress)
     {
         makeType(type.type, reg);
     }
@@ -606,81 +727,102 @@ void CodeGenVisitor::visitIdExpression(IdExpression* expr, const int reg) {
 }
 
 void CodeGenVisitor::visitBinaryExpression(BinaryExpression* expr, const int reg) {
-    int r = allocator.allocate();
+    if(isLogic(expr->op)) {
+        // && and || as values branch like in a condition and materialize 0 or 1
+        const std::string name = ".logic" + std::to_string(logicIndex++);
+        emitBranch(expr, false, func.top()->id.name + name + "_false");
+        textSegment.push_back(new Move(GPREGS[reg], "1"));
+        textSegment.push_back(new Jump("jmp", func.top()->id.name + name + "_end"));
+        textSegment.push_back(new Label(name + "_false"));
+        textSegment.push_back(new XOR(GPREGS32[reg], GPREGS32[reg]));
+        textSegment.push_back(new Label(name + "_end"));
+        expr->type = TypeIdentifier{TypeIdentifierType::BOOL, 0};
+        return;
+    }
+
+    const bool divide = expr->op == BinaryOperator::DIV || expr->op == BinaryOperator::MOD;
     int lr = reg;
 
-    int cmpReg1 = allocator.allocate();
-    int cmpReg2 = allocator.allocate();
+    // A left operand that has to survive a call on the right waits in a
+    // callee-saved register instead of being saved around the call.
+    int held = -1;
+    if(containsCall(expr->right)) {
+        held = allocator.allocateCalleeSaved();
+        lr = held;
+    }
 
-    if((expr->op == BinaryOperator::DIV || expr->op == BinaryOperator::MOD) && reg != 7) {
+    bool savedRax = false;
+    if(divide && reg != 7 && held == -1) {
         lr = 7;
-        if(usedRegs[0]) push("rax");
+        savedRax = live[7];
+        if(savedRax) push("rax");
     }
 
     expr->left->accept(this, lr);
+    live[lr] = true;
+    int r = allocator.allocate();
     expr->right->accept(this, r);
+    live[lr] = false;
+
+    if(divide && held != -1) {
+        if(reg != 7) {
+            savedRax = live[7];
+            if(savedRax) push("rax");
+        }
+        textSegment.push_back(new Move("rax", GPREGS[held]));
+        lr = 7;
+    }
 
-    std::string lReg, rReg, regMov;
-    std::string cmp1 = GPREGS[cmpReg1];
-    std::string cmp2 = GPREGS[cmpReg2];
+    std::string lReg, rReg;
     auto type = expr->right->type;
     expr->type = type;
     bool sign = false;
 
-    switch (type.type) {
+    // pointers are compared and offset as full width unsigned values
+    switch (type.ptrDepth > 0 ? TypeIdentifierType::U64 : type.type) {
     case TypeIdentifierType::I8:
         lReg = GPREGS8[lr];
         rReg = GPREGS8[r];
-        regMov = GPREGS8[cmpReg1];
         sign = true;
         break;
     case TypeIdentifierType::I16:
         lReg = GPREGS16[lr];
         rReg = GPREGS16[r];
-        regMov = GPREGS16[cmpReg1];
         sign = true;
         break;
     case TypeIdentifierType::I32:
         lReg = GPREGS32[lr];
         rReg = GPREGS32[r];
-        regMov = GPREGS32[cmpReg1];
         sign = true;
         break;
     case TypeIdentifierType::I64:
         lReg = GPREGS[lr];
         rReg = GPREGS[r];
-        regMov = GPREGS[cmpReg1];
         sign = true;
         break;
     case TypeIdentifierType::U8:
         lReg = GPREGS8[lr];
         rReg = GPREGS8[r];
-        regMov = GPREGS8[cmpReg1];
         break;
     case TypeIdentifierType::U16:
         lReg = GPREGS16[lr];
         rReg = GPREGS16[r];
-        regMov = GPREGS16[cmpReg1];
         break;
     case TypeIdentifierType::U32:
         lReg = GPREGS32[lr];
         rReg = GPREGS32[r];
-        regMov = GPREGS32[cmpReg1];
         break;
     case TypeIdentifierType::U64:
         lReg = GPREGS[lr];
         rReg = GPREGS[r];
-        regMov = GPREGS[cmpReg1];
         break;
     case TypeIdentifierType::CHAR:
         lReg = GPREGS8[lr];
         rReg = GPREGS8[r];
-        regMov = GPREGS8[cmpReg1];
         break;
     case TypeIdentifierType::BOOL:
         lReg = GPREGS8[lr];
         rReg = GPREGS8[r];
-        regMov = GPREGS8[cmpReg1];
         break;
     case TypeIdentifierType::F32:
     case TypeIdentifierType::F64:
@@ -696,20 +838,22 @@ void CodeGenVisitor::visitBinaryExpression(BinaryExpression* expr, const int reg
         textSegment.push_back(new Sub(lReg, rReg, sign));
     }
     else if(expr->op == BinaryOperator::MUL) {
-        textSegment.push_back(new Multiply(lReg, rReg, sign));
+        // mul has no two operand form; the low half of the product is the
+        // same for signed and unsigned operands
+        textSegment.push_back(new Multiply(lReg, rReg, true));
     }
     else if(expr->op == BinaryOperator::DIV) {
-        if(usedRegs[3]) push("rdx");
+        if(live[10]) push("rdx");
         textSegment.push_back(new XOR("rdx", "rdx"));
         textSegment.push_back(new Div(rReg, sign));
-        if(usedRegs[3]) pop("rdx");
+        if(live[10]) pop("rdx");
     }
     else if(expr->op == BinaryOperator::MOD) {
-        if(usedRegs[3]) push("rdx");
+        if(live[10]) push("rdx");
         textSegment.push_back(new XOR("rdx", "rdx"));
         textSegment.push_back(new Div(rReg, sign));
         textSegment.push_back(new Move(lReg, "rdx"));
-        if(usedRegs[3]) pop("rdx");
+        if(live[10]) pop("rdx");
     }
     else if(expr->op == BinaryOperator::BIT_OR) {
         textSegment.push_back(new OR(lReg, rReg));
@@ -718,56 +862,29 @@ void CodeGenVisitor::visitBinaryExpression(BinaryExpression* expr, const int reg
         textSegment.push_back(new AND(lReg, rReg));
     }
     else {
-        textSegment.push_back(new Comparison(lReg, rReg, cmp1, cmp2, regMov, expr->op));
+        // only comparisons need scratch registers, taking them for every
+        // operator would make leaves save callee-saved registers they never use
+        const int cmpReg1 = allocator.allocate();
+        const int cmpReg2 = allocator.allocate();
+        const std::string cc = conditionCode(expr->op, comparesSigned(expr), false);
+        textSegment.push_back(new Comparison(lReg, rReg, GPREGS[cmpReg1], GPREGS[cmpReg2], GPREGS[lr], cc));
+        allocator.free(cmpReg1);
+        allocator.free(cmpReg2);
     }
     allocator.free(r);
-    allocator.free(cmpReg1);
-    allocator.free(cmpReg2);
 
-    deref(expr->derefDepth, type.ptrDepth, lReg, GPREGS[reg]);
-
-    if(lr == 7 && reg != 7) {
-        textSegment.push_back(new Move(GPREGS[reg], lReg));
-        if(usedRegs[0]) pop("rax");
+    if(lr != reg) {
+        textSegment.push_back(new Move(GPREGS[reg], GPREGS[lr]));
+        if(savedRax) pop("rax");
     }
+    if(held != -1) allocator.free(held);
+
+    deref(expr->derefDepth, type.ptrDepth, GPREGS[reg], GPREGS[reg]);
 }
 
 void CodeGenVisitor::visitCallExpression(CallExpression* expr, int reg) {
-    for(int i = 0; i < std::size(usedRegs); i++) {
-        if(usedRegs[i]) push(GPREGS[i+FIRST_ARG]);
-    }
-    usedRegStack.push(usedRegs);
-    for(bool& b : usedRegs) b = false;
-
-    if(expr->id.name == "syscall") {
-        for (int i = 0; i < expr->args.size(); i++)
-        {
-            expr->args.at(i)->accept(this, i+FIRST_ARG);
-            usedRegs[i] = true;
-        }
-
-        textSegment.push_back(new Syscall());
-    }
-    else {
-        for (int i = 0; i < expr->args.size(); i++)
-        {
-            auto arg = expr->args.at(i);
-            arg->accept(this, i+FIRST_ARG+1);
-            usedRegs[i+1] = true;
-        }
-        textSegment.push_back(new Call(expr->id.name));
-    }
-
-    if (reg != 7)
-        textSegment.push_back(new Move(GPREGS[reg], "rax"));
-
-    std::swap(usedRegs, usedRegStack.top());
-    usedRegStack.pop();
-    for(int i = std::size(usedRegs)-1; i >= 0; i--) {
-        if(usedRegs[i]) {
-            pop(GPREGS[i+FIRST_ARG]);
-        }
-    }
+    emitCallSite(expr->id.name, expr->args, reg);
+    expr->type = callType(expr->id.name);
 }
 
 void CodeGenVisitor::visitCompound(Compound* stmt) {
@@ -779,108 +896,101 @@ void CodeGenVisitor::visitEndCompound(EndCompound* stmt) {
 }
 
 void CodeGenVisitor::visitIf(If* stmt) {
-    int reg = allocator.allocate();
     int index = ifIndex++;
 
-    stmt->condition->accept(this, reg);
-    textSegment.push_back(new Compare(GPREGS[reg], "0"));
-    allocator.free(reg);
-    textSegment.push_back(new Jump("je", func.top()->id.name + ".If" + std::to_string(index) + "_End"));
+    // never taken while profiling counts as cold as well
+    const std::optional<long long> taken = executionCount(":if" + std::to_string(index) + ":then");
+    const bool untaken = taken.has_value() && *taken == 0 && executionCount("").value_or(0) > 0;
+    if(untaken || CallGraph::isCold(stmt->body, functions)) {
+        // the body is an error path; it is moved behind the epilogue and
+        // jumps back, so the hot path falls straight through
+        emitBranch(stmt->condition, true, func.top()->id.name + ".If" + std::to_string(index) + "_Cold");
+        const size_t start = textSegment.size();
+        textSegment.push_back(new Label(".If" + std::to_string(index) + "_Cold"));
+        countExecution(":if" + std::to_string(index) + ":then");
+        stmt->body->accept(this);
+        textSegment.push_back(new Jump("jmp", func.top()->id.name + ".If" + std::to_string(index) + "_End"));
+        coldSegment.insert(coldSegment.end(), textSegment.begin() + static_cast<long>(start), textSegment.end());
+        textSegment.resize(start);
+        textSegment.push_back(new Label(".If" + std::to_string(index) + "_End"));
+        return;
+    }
+
+    emitBranch(stmt->condition, false, func.top()->id.name + ".If" + std::to_string(index) + "_End");
+    countExecution(":if" + std::to_string(index) + ":then");
     stmt->body->accept(this);
     textSegment.push_back(new Label(".If" + std::to_string(index) + "_End"));
 }
 
 void CodeGenVisitor::visitIfElse(IfElse* stmt) {
-    int reg = allocator.allocate();
     int index = ifIndex++;
-
-    stmt->condition->accept(this, reg);
-    textSegment.push_back(new Compare(GPREGS[reg], "0"));
-    allocator.free(reg);
-    textSegment.push_back(new Jump("je", func.top()->id.name + ".If" + std::to_string(index) + "_Else"));
+    const std::string then = ":if" + std::to_string(index) + ":then";
+    const std::string otherwise = ":if" + std::to_string(index) + ":else";
+
+    // the arm that ran more often while profiling falls through
+    if(executionCount(otherwise).value_or(0) > executionCount(then).value_or(0)) {
+        emitBranch(stmt->condition, true, func.top()->id.name + ".If" + std::to_string(index) + "_Then");
+        countExecution(otherwise);
+        stmt->elseBody->accept(this);
+        textSegment.push_back(new Jump("jmp", func.top()->id.name + ".If" + std::to_string(index) + "_End"));
+        textSegment.push_back(new Label(".If" + std::to_string(index) + "_Then"));
+        countExecution(then);
+        stmt->ifBody->accept(this);
+        textSegment.push_back(new Label(".If" + std::to_string(index) + "_End"));
+        return;
+    }
+
+    emitBranch(stmt->condition, false, func.top()->id.name + ".If" + std::to_string(index) + "_Else");
+    countExecution(then);
     stmt->ifBody->accept(this);
     textSegment.push_back(new Jump("jmp",func.top()->id.name + ".If" + std::to_string(index) + "_End"));
     textSegment.push_back(new Label(".If" + std::to_string(index) + "_Else"));
+    countExecution(otherwise);
     stmt->elseBody->accept(this);
     textSegment.push_back(new Label(".If" + std::to_string(index) + "_End"));
 }
 
 void CodeGenVisitor::visitReturn(Return* stmt) {
-    if(func.top()->returnType.type != TypeIdentifierType::VOID) {
+    if((func.top()->returnType.type != TypeIdentifierType::VOID || func.top()->returnType.ptrDepth > 0) && stmt->value != nullptr) {
         stmt->value->accept(this, 7);
     }
 
-    int r = allocator.allocate();
-    for(int i = 0; i < func.top()->args.size(); i++) {
-        pop(allocator.getReg(r));
-    }
-    allocator.free(r);
-
-    bool* wasUsed = allocator.getWasUsed();
-
-    for(int i = std::size(REGS)-1; i >= 0; i--) {
-        if(wasUsed[i]) {
-            pop(REGS[i]);
-        }
-    }
-
-    textSegment.push_back(new Move("rsp", "rbp"));
-    textSegment.push_back(new Pop("rbp"));
-    offset = 0;
-    textSegment.push_back(new ReturnOp());
-
-    if(!parameterStack.empty()) {
-        parameters = parameterStack.top();
-        parameterStack.pop();
-    }
-    func.pop();
+    returnJump = new Jump("jmp", func.top()->id.name + ".return");
+    textSegment.push_back(returnJump);
 }
 
 void CodeGenVisitor::visitCallStatement(CallStatement* stmt) {
-    for(int i = 0; i < std::size(usedRegs); i++) {
-        if(usedRegs[i]) push(GPREGS[i+FIRST_ARG]);
-    }
-    usedRegStack.push(usedRegs);
-    for(bool& b : usedRegs) b = false;
-
-    if(stmt->id.name == "syscall") {
-        for (int i = 0; i < stmt->arguments.size(); i++)
-        {
-            stmt->arguments.at(i)->accept(this, i+FIRST_ARG);
-            usedRegs[i] = true;
-        }
-
-        textSegment.push_back(new Syscall());
-    } else {
-        for (int i = 0; i < stmt->arguments.size(); i++)
-        {
-            auto arg = stmt->arguments.at(i);
-            arg->accept(this, i+FIRST_ARG+1);
-            usedRegs[i+1] = true;
-        }
-        textSegment.push_back(new Call(stmt->id.name));
-    }
-
-    std::swap(usedRegs, usedRegStack.top());
-    usedRegStack.pop();
-    for(int i = std::size(usedRegs)-1; i >= 0; i--) {
-        if(usedRegs[i]) {
-            pop(GPREGS[i+FIRST_ARG]);
-        }
-    }
+    emitCallSite(stmt->id.name, stmt->arguments);
 }
 
 void CodeGenVisitor::visitVarAssignment(VarAssignment *stmt) {
-    int left = allocator.allocate();
-    int right = allocator.allocate();
-    
-    loadAddress = true;
-    stmt->lhs->accept(this, left);
-    loadAddress = false;
-    stmt->rhs->accept(this, right);
+    int left, right;
+    // Whichever side calls something goes first, so the other side never
+    // has to survive the call.
+    if(containsCall(stmt->rhs) && !containsCall(stmt->lhs)) {
+        right = allocator.allocate();
+        stmt->rhs->accept(this, right);
+        live[right] = true;
+        left = allocator.allocate();
+        loadAddress = true;
+        stmt->lhs->accept(this, left);
+        loadAddress = false;
+        live[right] = false;
+    } else {
+        left = containsCall(stmt->rhs) ? allocator.allocateCalleeSaved() : allocator.allocate();
+        loadAddress = true;
+        stmt->lhs->accept(this, left);
+        loadAddress = false;
+        live[left] = true;
+        right = allocator.allocate();
+        stmt->rhs->accept(this, right);
+        live[left] = false;
+    }
 
     std::string rightString;
-    switch (stmt->lhs->type.type)
+    auto* target = dynamic_cast<IdExpression*>(stmt->lhs);
+    const bool pointer = target != nullptr && target->index == nullptr && target->derefDepth == 0 && target->type.ptrDepth > 0;
+    switch (pointer ? TypeIdentifierType::U64 : stmt->lhs->type.type)
     {
     case TypeIdentifierType::I8:
     case TypeIdentifierType::U8:
@@ -912,18 +1022,25 @@ void CodeGenVisitor::visitVarAssignment(VarAssignment *stmt) {
 
 void CodeGenVisitor::visitVarDeclaration(VarDeclaration* stmt) {
     if(func.top() != nullptr) {
-        push("qword 0");
-        current->addVar(stmt->id, Var{offset, stmt->type});
+        const int off = frame->getOffset(stmt);
+        if(stmt->size != nullptr) {
+            current->addVar(stmt->id, Var{static_cast<size_t>(off), stmt->type, true});
+        } else {
+            textSegment.push_back(new Move(sizeName(FrameLayout::slotSize(stmt->type)) + " " + slot(off), "0"));
+            current->addVar(stmt->id, Var{static_cast<size_t>(off), stmt->type});
+        }
     } else {
         if(stmt->size != nullptr) {
             IntLit* value = dynamic_cast<IntLit*>(stmt->size);
             if(value == nullptr) {
                 throw std::runtime_error("expected IntLit but found: " + stmt->size->toString(0));
             }
+            beginSection(bssSegment, ".bss", stmt->id.name);
             bssSegment.push_back(new DefineVar(stmt->id.name, "resb", std::to_string(value->value)));
             globalVars.insert({stmt->id.name, stmt->type});
             globals.push_back(stmt->id.name);
         } else {
+            beginSection(dataSegment, ".data", stmt->id.name);
             dataSegment.push_back(new DefineVar(stmt->id.name, "dq", "0"));
             globalVars.insert({stmt->id.name, stmt->type});
             globals.push_back(stmt->id.name);
@@ -934,28 +1051,26 @@ void CodeGenVisitor::visitVarDeclaration(VarDeclaration* stmt) {
 void CodeGenVisitor::visitVarDeclAssign(VarDeclAssign* stmt) {
     if(func.top() != nullptr) {
         int r = allocator.allocate();
+        const int off = frame->getOffset(stmt);
         stmt->value->accept(this, r);
-        makeType(stmt->type.type, r);
-        push(allocator.getReg(r));
-        current->addVar(stmt->id, Var{offset, stmt->type});
+        store(slot(off), r, stmt->type);
+        current->addVar(stmt->id, Var{static_cast<size_t>(off), stmt->type});
         allocator.free(r);
     }
     else {
         IntLit* expr = dynamic_cast<IntLit*>(stmt->value);
         StringLit* str = dynamic_cast<StringLit*>(stmt->value);
+        auto& segment = stmt->constant ? ROSegment : dataSegment;
+        if(expr != nullptr || str != nullptr) {
+            beginSection(segment, stmt->constant ? ".rodata" : ".data", stmt->id.name);
+        }
         if(expr != nullptr) {
-            if(stmt->constant)
-                ROSegment.push_back(new DefineVar(stmt->id.name, "dq", std::to_string(expr->value)));
-            else 
-                dataSegment.push_back(new DefineVar(stmt->id.name, "dq", std::to_string(expr->value)));
+            segment.push_back(new DefineVar(stmt->id.name, "dq", std::to_string(expr->value)));
             globalVars.insert({stmt->id.name, stmt->type});
             globals.push_back(stmt->id.name);
         }
         else if(str != nullptr) {
-            if(stmt->constant)
-                ROSegment.push_back(new DefineVar(stmt->id.name, "db", str->value));
-            else
-                dataSegment.push_back(new DefineVar(stmt->id.name, "db", str->value));
+            segment.push_back(new DefineVar(stmt->id.name, "db", str->value));
             globalVars.insert({stmt->id.name, stmt->type});
             globals.push_back(stmt->id.name);
         }
@@ -968,66 +1083,364 @@ void CodeGenVisitor::visitVarDeclAssign(VarDeclAssign* stmt) {
 
 void CodeGenVisitor::visitWhile(While* stmt)
 {
-    int r = allocator.allocate();
+    VectorLoop loop;
+    auto lookup = [this](const Identifier& id) { return lookupType(id); };
+    if(options.vectorize && LoopVectorizer::match(stmt, lookup, loop)) {
+        emitVectorLoop(loop);
+        return;
+    }
 
     int i = whileIndex++;
+    // loops that never iterated while profiling aren't worth the padding
+    if(executionCount(":while" + std::to_string(i)).value_or(1) > 0) textSegment.push_back(new Align(CODE_ALIGNMENT));
     textSegment.push_back(new Label(".while" + std::to_string(i) + "_start"));
-    stmt->condition->accept(this, r);
-    textSegment.push_back(new Compare(GPREGS8[r], "0"));
-    allocator.free(r);
-    textSegment.push_back(new Jump("je", func.top()->id.name + ".while" + std::to_string(i) + "_end"));
-    Scope* old = current;
+    emitBranch(stmt->condition, false, func.top()->id.name + ".while" + std::to_string(i) + "_end");
     stmt->body->accept(this);
-    if (old != current)
-    {
-        int reg = allocator.allocate();
-        for(int i = 0; i < current->getNumVars(); i++) {
-            pop(GPREGS[reg]);
-        }
-        allocator.free(reg);
-    }
+    countExecution(":while" + std::to_string(i));
     textSegment.push_back(new Jump("jmp", func.top()->id.name + ".while" + std::to_string(i) + "_start"));
     textSegment.push_back(new Label(".while" + std::to_string(i) + "_end"));
+}
 
-    allocator.free(r);
+void CodeGenVisitor::visitSwitch(Switch* stmt) {
+    const std::string name = ".switch" + std::to_string(switchIndex);
+    const std::string fn = func.top()->id.name;
+
+    int reg = allocator.allocate();
+    stmt->value->accept(this, reg);
+
+    // widen to 64 bits so the case values can be compared directly
+    const TypeIdentifier type = stmt->value->type;
+    const int width = typeWidth(type);
+    const bool sign = typeSigned(type);
+    if(width == 4) {
+        if(sign) textSegment.push_back(new MoveExtend("movsxd", GPREGS[reg], GPREGS32[reg]));
+        else textSegment.push_back(new Move(GPREGS32[reg], GPREGS32[reg]));
+    } else if(width < 4) {
+        textSegment.push_back(new MoveExtend(sign ? "movsx" : "movzx", GPREGS[reg], sizedReg(reg, width)));
+    }
+
+    // case values wrap like the switch value does
+    const std::vector<long long> values = SwitchEmitter::wrapCases(stmt, width, sign);
+    std::vector<SwitchEmitter::Case> cases;
+    size_t next = 0;
+    for(size_t i = 0; i < stmt->cases.size(); i++) {
+        for(size_t k = 0; k < stmt->cases.at(i).values.size(); k++) {
+            cases.push_back({values.at(next++), fn + name + "_case" + std::to_string(i)});
+        }
+    }
+    const std::string end = name + "_end";
+    const std::string fallback = stmt->defaultBody != nullptr ? name + "_default" : end;
+
+    int scratch = allocator.allocate();
+    SwitchEmitter(textSegment, ROSegment, fn, switchIndex++).emit(GPREGS[reg], GPREGS[scratch], cases, fn + fallback, sign);
+    allocator.free(scratch);
+    allocator.free(reg);
+
+    for(size_t i = 0; i < stmt->cases.size(); i++) {
+        textSegment.push_back(new Label(name + "_case" + std::to_string(i)));
+        stmt->cases.at(i).body->accept(this);
+        textSegment.push_back(new Jump("jmp", fn + end));
+    }
+    if(stmt->defaultBody != nullptr) {
+        textSegment.push_back(new Label(name + "_default"));
+        stmt->defaultBody->accept(this);
+    }
+    textSegment.push_back(new Label(end));
 }
 
-void CodeGenVisitor::visitFunctionDefinition(FunctionDefinition *def) {
-    globals.push_back(def->id.name);
-    textSegment.push_back(new Label(def->id.name));
-    textSegment.push_back(new Push("rbp"));
-    textSegment.push_back(new Move("rbp", "rsp"));
+// Jumps to target if cond evaluates to when and falls through otherwise.
+// The right operand of && and || is skipped once the left one decides the
+// result, and comparisons turn into a cmp/jcc pair without materializing
+// a boolean.
+void CodeGenVisitor::emitBranch(Expression* cond, const bool when, const std::string& target) {
+    auto* binary = dynamic_cast<BinaryExpression*>(cond);
+
+    if(binary != nullptr && binary->derefDepth == 0 && isLogic(binary->op)) {
+        // a && b is decided by a being false, a || b by a being true
+        const bool decides = binary->op == BinaryOperator::LOGIC_OR;
+        if(when == decides) {
+            emitBranch(binary->left, when, target);
+            emitBranch(binary->right, when, target);
+        } else {
+            const std::string skip = ".logic" + std::to_string(logicIndex++) + "_skip";
+            emitBranch(binary->left, decides, func.top()->id.name + skip);
+            emitBranch(binary->right, when, target);
+            textSegment.push_back(new Label(skip));
+        }
+        return;
+    }
 
-    offsetStack.push(offset);
-    offset = 0;
+    if(binary != nullptr && binary->derefDepth == 0 && isComparison(binary->op)) {
+        int left = containsCall(binary->right) ? allocator.allocateCalleeSaved() : allocator.allocate();
+        binary->left->accept(this, left);
+        live[left] = true;
+        int right = allocator.allocate();
+        binary->right->accept(this, right);
+        live[left] = false;
 
-    CodeGenVisitor visit;
-    visit.setParams(def->args);
+        const int width = typeWidth(binary->right->type);
+        textSegment.push_back(new Compare(sizedReg(left, width), sizedReg(right, width)));
+        textSegment.push_back(new Jump("j" + conditionCode(binary->op, comparesSigned(binary), !when), target));
+        allocator.free(left);
+        allocator.free(right);
+        return;
+    }
+
+    int reg = allocator.allocate();
+    cond->accept(this, reg);
+    textSegment.push_back(new Test(GPREGS[reg], GPREGS[reg]));
+    allocator.free(reg);
+    textSegment.push_back(new Jump(when ? "jnz" : "jz", target));
+}
+
+void CodeGenVisitor::emitVectorLoop(const VectorLoop& loop) {
+    // Load the loop inputs into the registers LoopVectorizer expects,
+    // run the vector loop and write the induction variable back.
+    loop.target->accept(this, FIRST_ARG + 1);
+    if(loop.source != nullptr) loop.source->accept(this, FIRST_ARG + 2);
+    loop.index->accept(this, FIRST_ARG + 3);
+    if(loop.bound != nullptr) loop.bound->accept(this, FIRST_ARG + 4);
+    if(loop.accumulator != nullptr) loop.accumulator->accept(this, FIRST_ARG + 5);
+    if(loop.value != nullptr) loop.value->accept(this, FIRST_ARG + 6);
+
+    LoopVectorizer vectorizer(textSegment, func.top()->id.name, inlineIndex++, options.avx2 ? 32 : 16);
+    vectorizer.emit(loop);
+
+    textSegment.push_back(new Move("qword " + variableOperand(loop.index->id), "rdx"));
+    if(loop.accumulator != nullptr) {
+        textSegment.push_back(new Move("qword " + variableOperand(loop.accumulator->id), "r8"));
+    }
+}
+
+// Evaluates the arguments into their ABI registers and calls name, leaving
+// the result in rax or, if given, in reg. Pending values the call would
+// clobber are pushed around it; values that have to survive a call are
+// normally placed in callee-saved registers up front, so this is rare.
+void CodeGenVisitor::emitCallSite(const std::string& name, const std::vector<Expression*>& args, const int reg) {
+    const bool syscall = name == "syscall";
+    const int firstReg = syscall ? FIRST_ARG : FIRST_ARG + 1;
+
+    std::vector<int> spilled;
+    auto clobber = [&](const int i) {
+        if(live[i] && std::find(spilled.begin(), spilled.end(), i) == spilled.end()) spilled.push_back(i);
+    };
+    if(syscall) {
+        for(int i : SYSCALL_CLOBBERED) clobber(i);
+        for(int i = 0; i < args.size(); i++) clobber(firstReg + i);
+        if(args.size() > SYSCALL_R10_ARG) clobber(1);
+    } else {
+        for(int i : CALL_CLOBBERED) clobber(i);
+    }
+    const auto outer = live;
+    for(int i : spilled) {
+        push(GPREGS[i]);
+        live[i] = false;
+    }
+
+    // Arguments that call something are evaluated first; all but the last
+    // of them wait in callee-saved registers. Everything else is evaluated
+    // straight into its ABI register afterwards.
+    int lastCall = -1;
+    for(int i = 0; i < args.size(); i++) {
+        if(containsCall(args.at(i))) lastCall = i;
+    }
+    std::vector<int> held(args.size(), -1);
+    for(int i = 0; i < lastCall; i++) {
+        if(!containsCall(args.at(i))) continue;
+        held.at(i) = allocator.allocateCalleeSaved();
+        args.at(i)->accept(this, held.at(i));
+        live[held.at(i)] = true;
+    }
+    if(lastCall != -1) {
+        args.at(lastCall)->accept(this, firstReg + lastCall);
+        live[firstReg + lastCall] = true;
+    }
+    for(int i = 0; i < args.size(); i++) {
+        if(containsCall(args.at(i))) continue;
+        args.at(i)->accept(this, firstReg + i);
+        live[firstReg + i] = true;
+    }
+    for(int i = 0; i < args.size(); i++) {
+        if(held.at(i) == -1) continue;
+        textSegment.push_back(new Move(GPREGS[firstReg + i], GPREGS[held.at(i)]));
+        allocator.free(held.at(i));
+    }
+
+    if(syscall) {
+        // the kernel takes the fourth argument in r10, rcx is lost to syscall
+        if(args.size() > SYSCALL_R10_ARG) textSegment.push_back(new Move("r10", GPREGS[firstReg + SYSCALL_R10_ARG]));
+        textSegment.push_back(new Syscall());
+    }
+    else emitCall(name, args);
+
+    if(reg != -1 && reg != 7) textSegment.push_back(new Move(GPREGS[reg], "rax"));
+    live = outer;
+    for(auto it = spilled.rbegin(); it != spilled.rend(); ++it) {
+        pop(GPREGS[*it]);
+    }
+}
+
+TypeIdentifier CodeGenVisitor::callType(const std::string& name) {
+    if(IntrinsicEmitter::isIntrinsic(name)) return IntrinsicEmitter::returnType(name);
+    if(functions.contains(name)) return functions.find(name)->second->returnType;
+    return TypeIdentifier{TypeIdentifierType::I64, 0};
+}
+
+void CodeGenVisitor::emitCall(const std::string& name, const std::vector<Expression*>& args) {
+    if(!IntrinsicEmitter::isIntrinsic(name)) {
+        textSegment.push_back(new Call(name));
+        return;
+    }
+    if(args.size() != IntrinsicEmitter::argumentCount(name)) {
+        throw std::runtime_error(name + " expects " + std::to_string(IntrinsicEmitter::argumentCount(name)) + " arguments");
+    }
+
+    std::optional<long long> size;
+    if(args.size() == 3) {
+        auto* lit = dynamic_cast<IntLit*>(args.at(2));
+        if(lit != nullptr && lit->derefDepth == 0) size = lit->value;
+    }
+    IntrinsicEmitter intrinsic(textSegment, func.top()->id.name, inlineIndex++, options.avx2 ? 32 : 16);
+    intrinsic.emit(name, size);
+}
+
+std::optional<TypeIdentifier> CodeGenVisitor::lookupType(const Identifier& id) {
+    if(current->getVar(id) != nullptr) return current->getVar(id)->type;
+    if(globalVars.contains(id.name)) return globalVars.find(id.name)->second;
+    return std::nullopt;
+}
+
+std::string CodeGenVisitor::variableOperand(const Identifier& id) {
+    if(current->getVar(id) != nullptr) {
+        return slot(current->getVar(id)->offset);
+    }
+    if(globalVars.contains(id.name)) return "[" + id.name + "]";
+    throw std::runtime_error("can't resolve symbol: \"" + id.name + "\"");
+}
+
+void CodeGenVisitor::visitFunctionDefinition(FunctionDefinition *def) {
+    TimeReport::Region region(timeReport, def->id.name, "function");
+    globals.push_back(def->id.name);
+    beginSection(textSegment, ".text", def->id.name);
+    textSegment.push_back(new Align(CODE_ALIGNMENT));
+    if(options.optimize) {
+        lowerOptimized(def);
+        return;
+    }
+
+    FrameLayout layout(def);
+    // Leaves whose slots and saved registers fit into the red zone below
+    // rsp don't need a frame at all.
+    const bool omitFrame = options.omitFramePointer && layout.isLeaf() &&
+        (layout.getSize() + 7) / 8 * 8 + 8 * static_cast<int>(std::size(TO_PRESERVE)) <= RED_ZONE;
+    if(!omitFrame || !emitFunction(def, layout, true)) {
+        emitFunction(def, layout, false);
+    }
+}
+
+// Generates the body and wraps it in a prologue and epilogue. A frameless
+// body must not push anything into the red zone; if it does, nothing is
+// emitted and false is returned.
+bool CodeGenVisitor::emitFunction(FunctionDefinition* def, FrameLayout& layout, const bool omitFrame) {
+    CodeGenVisitor visit(options);
+    visit.setFrame(&layout, omitFrame);
+    visit.setStringPool(strings);
+    visit.setProfile(profile);
+    visit.getScratchAlloctor()->preferCallerSaved(layout.isLeaf());
     visit.pushFuncDef(def);
+    visit.setParams(def->args);
     visit.addGlobals(globalVars);
+    visit.addFunctions(functions);
 
+    visit.countExecution("");
     def->body->accept(&visit);
+
+    std::vector<OpCode*> body = visit.getTextSegment();
+    std::vector<OpCode*> cold = visit.getColdSegment();
+    if(omitFrame) {
+        for(OpCode* op : body) {
+            if(dynamic_cast<Push*>(op) != nullptr) return false;
+        }
+        for(OpCode* op : cold) {
+            if(dynamic_cast<Push*>(op) != nullptr) return false;
+        }
+    }
+
+    // Callee-saved registers the body used get a slot below the locals.
+    std::vector<std::pair<std::string, int>> saved;
+    int frameSize = (layout.getSize() + 7) / 8 * 8;
     bool* wasUsed = visit.getScratchAlloctor()->getWasUsed();
-    for(int i = 0; i < std::size(REGS); i++) {
+    for(int i : TO_PRESERVE) {
         if(wasUsed[i]) {
-            push(GPREGS[i]);
+            frameSize += 8;
+            saved.emplace_back(REGS[i], frameSize);
         }
     }
+    frameSize = (frameSize + 15) / 16 * 16;
+
+    textSegment.push_back(new Label(def->id.name));
+    if(!omitFrame) {
+        textSegment.push_back(new Push("rbp"));
+        textSegment.push_back(new Move("rbp", "rsp"));
+        if(frameSize > 0) textSegment.push_back(new Sub("rsp", std::to_string(frameSize)));
+    }
+    for(const auto& [reg, off] : saved) {
+        textSegment.push_back(new Move(visit.slot(off), reg));
+    }
 
-    for(auto op : visit.getTextSegment()) {
+    // a trailing return falls through into the epilogue
+    if(!body.empty() && body.back() == visit.getReturnJump()) {
+        body.pop_back();
+    }
+    for(auto op : body) {
         textSegment.push_back(op);
     }
     for(auto op : visit.getDataSegment()) {
         dataSegment.push_back(op);
     }
+    if(!visit.getROSegment().empty()) beginSection(ROSegment, ".rodata", def->id.name);
+    for(auto op : visit.getROSegment()) {
+        ROSegment.push_back(op);
+    }
 
-    func.push(def);
+    textSegment.push_back(new Label(".return"));
+    for(const auto& [reg, off] : saved) {
+        textSegment.push_back(new Move(reg, visit.slot(off)));
+    }
+    if(!omitFrame) textSegment.push_back(new Leave());
+    textSegment.push_back(new ReturnOp());
+    textSegment.insert(textSegment.end(), cold.begin(), cold.end());
+    return true;
+}
+
+void CodeGenVisitor::lowerOptimized(FunctionDefinition* def) {
+    functions.insert({def->id.name, def});
+
+    IRBuilder builder(globalVars, functions);
+    IRFunction* function = builder.lower(def);
+
+    PassManager passes;
+    passes.addStandardPasses();
+    passes.setPrintAfterEach(options.printIR);
+    passes.run(function);
+
+    std::vector<OpCode*> tables;
+    InstructionSelector selector(textSegment, tables, *strings, options.avx2 ? 32 : 16, options.omitFramePointer);
+    selector.select(function);
+    if(!tables.empty()) beginSection(ROSegment, ".rodata", def->id.name);
+    ROSegment.insert(ROSegment.end(), tables.begin(), tables.end());
 }
 
 void CodeGenVisitor::visitProgram(Program* prog) {
     for(auto glob : prog->externVars) {
         globalVars.insert(glob);
     }
+    for(auto func : prog->externFunctions) {
+        functions.insert(func);
+    }
+    for(auto def : prog->functions) {
+        functions.insert({def->id.name, def});
+    }
 }
 
 void CodeGenVisitor::deref(const int depth, const int typeDepth, const std::string& reg, const std::string& addr)
@@ -1041,9 +1454,10 @@ void CodeGenVisitor::deref(const int depth, const int typeDepth, const std::stri
     }
 }
 
+// Widens the low bytes of reg to 64 bits by the type's signedness, like
+// EXTEND and LOAD do in the IR path.
 void CodeGenVisitor::makeType(const TypeIdentifierType type, const int reg)
 {
-    int r = allocator.allocate();
     switch (type)
     {
     case TypeIdentifierType::I64:
@@ -1051,24 +1465,24 @@ void CodeGenVisitor::makeType(const TypeIdentifierType type, const int reg)
     case TypeIdentifierType::F64:
         break;
     case TypeIdentifierType::I8:
+        textSegment.push_back(new MoveExtend("movsx", GPREGS[reg], GPREGS8[reg]));
+        break;
     case TypeIdentifierType::U8:
     case TypeIdentifierType::CHAR:
-        textSegment.push_back(new XOR(ScratchAllocator::getReg(r), ScratchAllocator::getReg(r)));
-        textSegment.push_back(new Move(ScratchAllocator::getReg8(r), GPREGS8[reg]));
-        textSegment.push_back(new Move(GPREGS[reg], ScratchAllocator::getReg(r)));
+        textSegment.push_back(new MoveExtend("movzx", GPREGS32[reg], GPREGS8[reg]));
         break;
     case TypeIdentifierType::I16:
+        textSegment.push_back(new MoveExtend("movsx", GPREGS[reg], GPREGS16[reg]));
+        break;
     case TypeIdentifierType::U16:
-        textSegment.push_back(new XOR(ScratchAllocator::getReg(r), ScratchAllocator::getReg(r)));
-        textSegment.push_back(new Move(ScratchAllocator::getReg16(r), GPREGS16[reg]));
-        textSegment.push_back(new Move(GPREGS8[reg], ScratchAllocator::getReg(r)));
+        textSegment.push_back(new MoveExtend("movzx", GPREGS32[reg], GPREGS16[reg]));
         break;
     case TypeIdentifierType::I32:
+        textSegment.push_back(new MoveExtend("movsxd", GPREGS[reg], GPREGS32[reg]));
+        break;
     case TypeIdentifierType::U32:
     case TypeIdentifierType::F32:
-        textSegment.push_back(new XOR(ScratchAllocator::getReg(r), ScratchAllocator::getReg(r)));
-        textSegment.push_back(new Move(ScratchAllocator::getReg32(r), GPREGS32[reg]));
-        textSegment.push_back(new Move(GPREGS[reg], ScratchAllocator::getReg(r)));
+        textSegment.push_back(new Move(GPREGS32[reg], GPREGS32[reg]));
         break;
     case TypeIdentifierType::VOID:
     case TypeIdentifierType::BOOL:
@@ -1076,16 +1490,90 @@ void CodeGenVisitor::makeType(const TypeIdentifierType type, const int reg)
         exit(EXIT_FAILURE);
       break;
     }
-    allocator.free(r);
 }
 
 void CodeGenVisitor::setParams(std::vector<FunctionDefinition::ParamData> p) {
     for(auto arg : p) {
-        push(GPREGS[arg.index+FIRST_ARG+1]);
-        current->addVar(Identifier{arg.name}, {offset, arg.type});
+        const int off = frame->getParamOffset(arg.index);
+        store(slot(off), arg.index+FIRST_ARG+1, arg.type);
+        current->addVar(Identifier{arg.name}, Var{static_cast<size_t>(off), arg.type});
+    }
+}
+
+std::string CodeGenVisitor::slot(const int off) const {
+    return (frameless ? "[rsp - " : "[rbp - ") + std::to_string(off) + "]";
+}
+
+// Loads a scalar local, sign extending signed narrow types and zero
+// extending the rest.
+void CodeGenVisitor::load(const int reg, const std::string& address, const TypeIdentifier& type) {
+    const int bytes = FrameLayout::slotSize(type);
+    const bool sign = typeSigned(type);
+    switch(bytes) {
+        case 1:
+        case 2:
+            textSegment.push_back(new MoveExtend(sign ? "movsx" : "movzx", sign ? GPREGS[reg] : GPREGS32[reg], sizeName(bytes) + " " + address));
+            break;
+        case 4:
+            if(sign) textSegment.push_back(new MoveExtend("movsxd", GPREGS[reg], "dword " + address));
+            else textSegment.push_back(new Move(GPREGS32[reg], "dword " + address));
+            break;
+        default:
+            textSegment.push_back(new Move(GPREGS[reg], "qword " + address));
+            break;
+    }
+}
+
+void CodeGenVisitor::store(const std::string& address, const int reg, const TypeIdentifier& type) {
+    switch(FrameLayout::slotSize(type)) {
+        case 1:
+            textSegment.push_back(new Move("byte " + address, GPREGS8[reg]));
+            break;
+        case 2:
+            textSegment.push_back(new Move("word " + address, GPREGS16[reg]));
+            break;
+        case 4:
+            textSegment.push_back(new Move("dword " + address, GPREGS32[reg]));
+            break;
+        default:
+            textSegment.push_back(new Move("qword " + address, GPREGS[reg]));
+            break;
+    }
+}
+
+std::string CodeGenVisitor::sizeName(const int bytes) {
+    switch(bytes) {
+        case 1: return "byte";
+        case 2: return "word";
+        case 4: return "dword";
+        default: return "qword";
     }
 }
 
+// With -ffunction-sections every function and global goes into a section
+// of its own, e.g. .text.<name>, so the linker can drop unused ones with
+// --gc-sections.
+void CodeGenVisitor::beginSection(std::vector<OpCode*>& segment, const std::string& kind, const std::string& name) const {
+    if(!options.functionSections) return;
+    std::string attributes;
+    if(kind == ".text") attributes = "progbits alloc exec nowrite align=16";
+    else if(kind == ".bss") attributes = "nobits alloc noexec write align=16";
+    else if(kind == ".data") attributes = "progbits alloc noexec write align=8";
+    else attributes = "progbits alloc noexec nowrite align=8";
+    segment.push_back(new Section(kind + "." + name, attributes));
+}
+
+// Points are keyed relative to the current function, see Profile.
+void CodeGenVisitor::countExecution(const std::string& point) {
+    if(!options.profileGenerate || profile == nullptr) return;
+    textSegment.push_back(new Add(profile->counter(func.top()->id.name + point), "1"));
+}
+
+std::optional<long long> CodeGenVisitor::executionCount(const std::string& point) const {
+    if(profile == nullptr || !profile->isLoaded()) return std::nullopt;
+    return profile->count(func.top()->id.name + point);
+}
+
 std::stack<size_t> CodeGenVisitor::getStack() {
     return offsetStack;
 }
@@ -10,7 +10,10 @@
 #include <stack>
 
 #include "OpCode.hpp"
+#include "Profile.hpp"
 #include "ScratchAllocator.h"
+#include "StringPool.hpp"
+#include "TimeReport.hpp"
 
 class Visitor;
 
@@ -216,6 +219,12 @@ public:
             case BinaryOperator::MOD:
                 out.append("Mod: ");
                 break;
+            case BinaryOperator::LOGIC_AND:
+                out.append("LogicAnd: ");
+                break;
+            case BinaryOperator::LOGIC_OR:
+                out.append("LogicOr: ");
+                break;
             }
         out.append("(");
         out.append(std::to_string(derefDepth));
@@ -536,6 +545,50 @@ public:
     Statement* body;
 };
 
+class Switch final : public Statement
+{
+public:
+    struct Case {
+        std::vector<long long> values;
+        Statement* body;
+    };
+
+    explicit Switch(Expression* value) {
+        this->value = value;
+    }
+
+    std::string toString(const int indentLevel) override
+    {
+        std::string out;
+        for(int i = 0; i < indentLevel; i++) out.append("  ");
+        out.append("Switch:\n");
+        for (int i = 0; i < indentLevel+1; i++) out.append("  ");
+        out.append("Value:\n");
+        out.append(value->toString(indentLevel+2));
+        for(const Case& c : cases) {
+            out.append("\n");
+            for (int i = 0; i < indentLevel+1; i++) out.append("  ");
+            out.append("Case");
+            for(long long v : c.values) out.append(" " + std::to_string(v));
+            out.append(":\n");
+            out.append(c.body->toString(indentLevel+2));
+        }
+        if(defaultBody != nullptr) {
+            out.append("\n");
+            for (int i = 0; i < indentLevel+1; i++) out.append("  ");
+            out.append("Default:\n");
+            out.append(defaultBody->toString(indentLevel+2));
+        }
+        return out;
+    }
+
+    void accept(Visitor* visitor) override;
+
+    Expression* value;
+    std::vector<Case> cases;
+    Statement* defaultBody = nullptr;
+};
+
 class FunctionDefinition {
 public:
     struct ParamData {
@@ -625,6 +678,7 @@ public:
 struct Var {
     size_t offset;
     TypeIdentifier type;
+    bool array = false;     // offset is the storage itself, not a pointer to it
 };
 
 class Scope {
@@ -682,6 +736,7 @@ public:
     virtual void visitVarDeclaration(VarDeclaration* stmt) = 0;
     virtual void visitVarDeclAssign(VarDeclAssign* stmt) = 0;
     virtual void visitWhile(While* stmt) = 0;
+    virtual void visitSwitch(Switch* stmt) = 0;
 
     virtual void visitFunctionDefinition(FunctionDefinition* def) = 0;
     virtual void visitProgram(Program* prog) = 0;
@@ -704,6 +759,7 @@ public:
     void visitVarAssignment(VarAssignment* stmt) override;
     void visitVarDeclaration(VarDeclaration* stmt) override;
     void visitVarDeclAssign(VarDeclAssign* stmt) override;
+    void visitSwitch(Switch* stmt) override;
 
     void visitFunctionDefinition(FunctionDefinition* def) override;
     void visitProgram(Program* prog) override;
@@ -733,6 +789,7 @@ public:
     void visitVarDeclaration(VarDeclaration* stmt) override;
     void visitVarDeclAssign(VarDeclAssign* stmt) override;
     void visitWhile(While* stmt) override;
+    void visitSwitch(Switch* stmt) override;
     void visitFunctionDefinition(FunctionDefinition* def) override;
     void visitProgram(Program* prog) override;
 
@@ -763,9 +820,22 @@ private:
     FunctionDefinition* currentFunction;
 };
 
+struct CodeGenOptions {
+    bool optimize = false;      // lower functions through the SSA IR (-O)
+    bool printIR = false;       // dump the IR after every pass (--print-ir)
+    bool vectorize = true;      // vectorize simple While loops (-fno-vectorize)
+    bool avx2 = false;          // use 32 byte AVX2 vectors instead of SSE2 (-mavx2)
+    bool omitFramePointer = false;  // no frame for leaves that fit in the red zone (-fomit-frame-pointer)
+    bool functionSections = false;  // one section per function and global (-ffunction-sections)
+    bool profileGenerate = false;   // count function entries, if arms and loop back-edges (--profile-generate)
+};
+
+struct VectorLoop;
+class FrameLayout;
+
 class CodeGenVisitor final : public Visitor {
 public:
-    CodeGenVisitor();
+    explicit CodeGenVisitor(const CodeGenOptions& options = {});
 
     void visitIntLit(IntLit* expr, int reg) override;
     void visitStringLit(StringLit* expr, int reg) override;
@@ -784,6 +854,7 @@ public:
     void visitVarDeclaration(VarDeclaration* stmt) override;
     void visitVarDeclAssign(VarDeclAssign* stmt) override;
     void visitWhile(While* stmt) override;
+    void visitSwitch(Switch* stmt) override;
 
     void visitFunctionDefinition(FunctionDefinition* def) override;
     void visitProgram(Program* prog) override;
@@ -794,7 +865,18 @@ public:
     std::vector<OpCode*> getTextSegment();
     std::vector<OpCode*> getBssSegment();
     std::vector<OpCode*> getROSegment();
+    // out of line code that goes behind the epilogue
+    std::vector<OpCode*> getColdSegment() { return coldSegment; }
+    // the jump to the epilogue emitted by the last return, if any
+    OpCode* getReturnJump() const { return returnJump; }
     std::vector<std::string> getGlobals();
+    // shared by the visitors of all functions of the module
+    StringPool& getStringPool() { return *strings; }
+    void setStringPool(StringPool* pool) { strings = pool; }
+    // counters for --profile-generate, counts for --profile-use
+    void setProfile(Profile* p) { profile = p; }
+    // every function is timed as a region of its own
+    void setTimeReport(TimeReport* report) { timeReport = report; }
 
     ScratchAllocator* getScratchAlloctor() { return &allocator; }
     void setParams(std::vector<FunctionDefinition::ParamData> p);
@@ -804,9 +886,33 @@ public:
         }
     }
 
+    inline void addFunctions(const std::map<std::string, FunctionDefinition*>& defs) {
+        for(const auto& pair : defs) {
+            functions.insert(pair);
+        }
+    }
+
     void pushFuncDef(FunctionDefinition* funcDef) { func.push(funcDef); }
+    void setFrame(FrameLayout* layout, const bool omitFrame = false) { frame = layout; frameless = omitFrame; }
 
 private:
+    void lowerOptimized(FunctionDefinition* def);
+    void emitVectorLoop(const VectorLoop& loop);
+    void emitBranch(Expression* cond, bool when, const std::string& target);
+    void emitCallSite(const std::string& name, const std::vector<Expression*>& args, int reg = -1);
+    void emitCall(const std::string& name, const std::vector<Expression*>& args);
+    TypeIdentifier callType(const std::string& name);
+    std::optional<TypeIdentifier> lookupType(const Identifier& id);
+    std::string variableOperand(const Identifier& id);
+    [[nodiscard]] std::string slot(int off) const;
+    bool emitFunction(FunctionDefinition* def, FrameLayout& layout, bool omitFrame);
+    static std::string sizeName(int bytes);
+    void beginSection(std::vector<OpCode*>& segment, const std::string& kind, const std::string& name) const;
+    void countExecution(const std::string& point);
+    [[nodiscard]] std::optional<long long> executionCount(const std::string& point) const;
+    void load(int reg, const std::string& address, const TypeIdentifier& type);
+    void store(const std::string& address, int reg, const TypeIdentifier& type);
+
     void push(const std::string& what, size_t bytes);
     void pop(const std::string& where, size_t bytes);
 
@@ -817,28 +923,41 @@ private:
 
     Scope* root;
     Scope* current;
+    FrameLayout* frame = nullptr;
+    bool frameless = false;
+    // GPREGS holding a value that is still needed while evaluating the rest of an expression
+    std::array<bool, 14> live{};
 
     std::stack<FunctionDefinition*> func;
     std::stack<size_t> offsetStack;
     std::stack<std::map<std::string, FunctionDefinition::ParamData>> parameterStack;
-    std::stack<std::array<bool, 7>> usedRegStack;
 
     std::map<std::string, FunctionDefinition::ParamData> parameters;
     std::map<std::string, TypeIdentifier> globalVars;
+    std::map<std::string, FunctionDefinition*> functions;
 
     std::vector<OpCode*> dataSegment;
     std::vector<OpCode*> textSegment;
     std::vector<OpCode*> bssSegment;
     std::vector<OpCode*> ROSegment;
+    std::vector<OpCode*> coldSegment;
+    OpCode* returnJump = nullptr;
     std::vector<std::string> globals;
+    StringPool ownStrings;
+    StringPool* strings = &ownStrings;
+    Profile* profile = nullptr;
+    TimeReport* timeReport = nullptr;
 
-    int stringIndex = 0;
     int whileIndex = 0;
+    int inlineIndex = 0;
     int ifIndex = 0;
+    int logicIndex = 0;
+    int switchIndex = 0;
 
     size_t offset = 0;
 
     ScratchAllocator allocator;
+    CodeGenOptions options;
 
     bool loadAddress = false;
 };
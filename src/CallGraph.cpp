@@ -0,0 +1,171 @@
+#include "CallGraph.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+const long long LOOP_WEIGHT = 10;
+// weights stop growing past a few nested loops
+const long long MAX_WEIGHT = 1000000;
+
+CallGraph::CallGraph(const Program* program) {
+    functions = program->externFunctions;
+    for(FunctionDefinition* def : program->functions) {
+        functions.insert({def->id.name, def});
+    }
+    for(FunctionDefinition* def : program->functions) {
+        collect(def->body, callees[def->id.name], 1);
+    }
+}
+
+std::set<std::string> CallGraph::reachableFrom(const std::string& root) const {
+    std::set<std::string> reached{root};
+    std::vector<std::string> work{root};
+    while(!work.empty()) {
+        const std::string name = work.back();
+        work.pop_back();
+        if(!callees.contains(name)) continue;
+        for(const auto& [callee, weight] : callees.find(name)->second) {
+            if(reached.insert(callee).second) work.push_back(callee);
+        }
+    }
+    return reached;
+}
+
+std::vector<FunctionDefinition*> CallGraph::order(const std::vector<FunctionDefinition*>& functions) const {
+    std::map<std::string, size_t> chainOf;
+    std::vector<std::vector<FunctionDefinition*>> chains;
+    for(FunctionDefinition* def : functions) {
+        chainOf.insert({def->id.name, chains.size()});
+        chains.push_back({def});
+    }
+
+    // undirected edges between functions of the module, heaviest first
+    std::map<std::pair<std::string, std::string>, long long> weights;
+    for(const auto& [caller, calls] : callees) {
+        if(!chainOf.contains(caller)) continue;
+        for(const auto& [callee, weight] : calls) {
+            if(callee == caller || weight == 0 || !chainOf.contains(callee)) continue;
+            weights[std::minmax(caller, callee)] += weight;
+        }
+    }
+    std::vector<std::tuple<long long, std::string, std::string>> edges;
+    for(const auto& [pair, weight] : weights) {
+        edges.emplace_back(weight, pair.first, pair.second);
+    }
+    std::stable_sort(edges.begin(), edges.end(), [](const auto& a, const auto& b) {
+        return std::get<0>(a) > std::get<0>(b);
+    });
+
+    auto position = [](const std::vector<FunctionDefinition*>& chain, const std::string& name) {
+        return static_cast<long long>(std::find_if(chain.begin(), chain.end(), [&](const FunctionDefinition* def) {
+            return def->id.name == name;
+        }) - chain.begin());
+    };
+    for(const auto& [weight, a, b] : edges) {
+        const size_t first = chainOf.find(a)->second;
+        const size_t second = chainOf.find(b)->second;
+        if(first == second) continue;
+        std::vector<FunctionDefinition*>& left = chains.at(first);
+        std::vector<FunctionDefinition*>& right = chains.at(second);
+
+        // of the four ways to concatenate the chains take the one that puts
+        // a and b closest together
+        const long long pa = position(left, a);
+        const long long pb = position(right, b);
+        const long long la = static_cast<long long>(left.size());
+        const long long lb = static_cast<long long>(right.size());
+        const long long distance[] = {la - 1 - pa + pb, la - 1 - pa + lb - 1 - pb, pa + pb, pa + lb - 1 - pb};
+        const long long best = std::min_element(std::begin(distance), std::end(distance)) - std::begin(distance);
+        if(best == 2 || best == 3) std::reverse(left.begin(), left.end());
+        if(best == 1 || best == 3) std::reverse(right.begin(), right.end());
+
+        for(FunctionDefinition* def : right) {
+            left.push_back(def);
+            chainOf[def->id.name] = first;
+        }
+        right.clear();
+    }
+
+    // chains keep the source order of their first function
+    std::vector<FunctionDefinition*> out;
+    for(const std::vector<FunctionDefinition*>& chain : chains) {
+        out.insert(out.end(), chain.begin(), chain.end());
+    }
+    return out;
+}
+
+bool CallGraph::isCold(Statement* body, const std::map<std::string, FunctionDefinition*>& functions) {
+    std::set<std::string> visiting;
+    return endsInNoReturn(body, functions, visiting);
+}
+
+bool CallGraph::noReturn(const std::string& name, const std::map<std::string, FunctionDefinition*>& functions, std::set<std::string>& visiting) {
+    if(!functions.contains(name) || !visiting.insert(name).second) return false;
+    const bool result = endsInNoReturn(functions.find(name)->second->body, functions, visiting);
+    visiting.erase(name);
+    return result;
+}
+
+bool CallGraph::endsInNoReturn(Statement* statement, const std::map<std::string, FunctionDefinition*>& functions, std::set<std::string>& visiting) {
+    if(auto* compound = dynamic_cast<Compound*>(statement)) {
+        // void functions end in an implicit return
+        auto last = std::find_if(compound->statements.rbegin(), compound->statements.rend(), [](Statement* stmt) {
+            auto* ret = dynamic_cast<Return*>(stmt);
+            return dynamic_cast<EndCompound*>(stmt) == nullptr && (ret == nullptr || ret->value != nullptr);
+        });
+        return last != compound->statements.rend() && endsInNoReturn(*last, functions, visiting);
+    }
+    auto* call = dynamic_cast<CallStatement*>(statement);
+    if(call == nullptr) return false;
+    if(call->id.name == "syscall") {
+        // exit and exit_group
+        auto* number = call->arguments.empty() ? nullptr : dynamic_cast<IntLit*>(call->arguments.front());
+        return number != nullptr && (number->value == 60 || number->value == 231);
+    }
+    return noReturn(call->id.name, functions, visiting);
+}
+
+void CallGraph::collect(Statement* statement, std::map<std::string, long long>& out, const long long weight) {
+    if(auto* stmt = dynamic_cast<Compound*>(statement)) {
+        for(Statement* child : stmt->statements) collect(child, out, weight);
+    } else if(auto* stmt = dynamic_cast<If*>(statement)) {
+        // calls on error paths keep their callees alive but don't pull them close
+        collect(stmt->condition, out, weight);
+        collect(stmt->body, out, isCold(stmt->body, functions) ? 0 : weight);
+    } else if(auto* stmt = dynamic_cast<IfElse*>(statement)) {
+        collect(stmt->condition, out, weight);
+        collect(stmt->ifBody, out, weight);
+        collect(stmt->elseBody, out, weight);
+    } else if(auto* stmt = dynamic_cast<While*>(statement)) {
+        const long long inner = std::min(weight * LOOP_WEIGHT, MAX_WEIGHT);
+        collect(stmt->condition, out, inner);
+        collect(stmt->body, out, inner);
+    } else if(auto* stmt = dynamic_cast<Switch*>(statement)) {
+        collect(stmt->value, out, weight);
+        for(const Switch::Case& c : stmt->cases) collect(c.body, out, weight);
+        if(stmt->defaultBody != nullptr) collect(stmt->defaultBody, out, weight);
+    } else if(auto* stmt = dynamic_cast<Return*>(statement)) {
+        if(stmt->value != nullptr) collect(stmt->value, out, weight);
+    } else if(auto* stmt = dynamic_cast<CallStatement*>(statement)) {
+        out[stmt->id.name] += weight;
+        for(Expression* arg : stmt->arguments) collect(arg, out, weight);
+    } else if(auto* stmt = dynamic_cast<VarAssignment*>(statement)) {
+        collect(stmt->lhs, out, weight);
+        collect(stmt->rhs, out, weight);
+    } else if(auto* stmt = dynamic_cast<VarDeclAssign*>(statement)) {
+        collect(stmt->value, out, weight);
+    }
+}
+
+void CallGraph::collect(Expression* expr, std::map<std::string, long long>& out, const long long weight) {
+    if(auto* id = dynamic_cast<IdExpression*>(expr)) {
+        out[id->id.name] += weight;
+        if(id->index != nullptr) collect(id->index, out, weight);
+    } else if(auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        collect(binary->left, out, weight);
+        collect(binary->right, out, weight);
+    } else if(auto* call = dynamic_cast<CallExpression*>(expr)) {
+        out[call->id.name] += weight;
+        for(Expression* arg : call->args) collect(arg, out, weight);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef CALL_GRAPH_HPP
+#define CALL_GRAPH_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "AST.hpp"
+
+// Which functions of a module call which and how often, statically: a call
+// inside a loop counts LOOP_WEIGHT times as much as one outside. A function
+// named as a value counts as called.
+class CallGraph {
+public:
+    explicit CallGraph(const Program* program);
+
+    // root and every function defined in the module that it reaches.
+    [[nodiscard]] std::set<std::string> reachableFrom(const std::string& root) const;
+
+    // Pettis-Hansen ordering: chains of functions are merged along the
+    // heaviest call edges first, so callers and callees end up adjacent.
+    [[nodiscard]] std::vector<FunctionDefinition*> order(const std::vector<FunctionDefinition*>& functions) const;
+
+    // Bodies ending in a call that never returns, e.g. sys_exit, are error
+    // paths and get placed out of line.
+    static bool isCold(Statement* body, const std::map<std::string, FunctionDefinition*>& functions);
+
+private:
+    void collect(Statement* statement, std::map<std::string, long long>& out, long long weight);
+    void collect(Expression* expr, std::map<std::string, long long>& out, long long weight);
+    static bool noReturn(const std::string& name, const std::map<std::string, FunctionDefinition*>& functions, std::set<std::string>& visiting);
+    static bool endsInNoReturn(Statement* statement, const std::map<std::string, FunctionDefinition*>& functions, std::set<std::string>& visiting);
+
+    std::map<std::string, FunctionDefinition*> functions;
+    std::map<std::string, std::map<std::string, long long>> callees;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "FrameLayout.hpp"
+#include "Intrinsics.hpp"
+#include "IR.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+FrameLayout::FrameLayout(FunctionDefinition* def) {
+    int start = 0;
+    std::vector<FunctionDefinition::ParamData> params = def->args;
+    paramOffsets.resize(params.size());
+    std::stable_sort(params.begin(), params.end(), [](const auto& a, const auto& b) {
+        return slotSize(a.type) > slotSize(b.type);
+    });
+    for(const auto& param : params) {
+        const int bytes = slotSize(param.type);
+        start = place(start, bytes, bytes);
+        paramOffsets.at(param.index) = start;
+    }
+
+    size = layoutNested(def->body, start);
+    leaf = !callsIn(def->body);
+}
+
+int FrameLayout::getOffset(const Statement* declaration) const {
+    if(!offsets.contains(declaration)) {
+        throw std::runtime_error("no stack slot for declaration");
+    }
+    return offsets.find(declaration)->second;
+}
+
+int FrameLayout::getParamOffset(const int index) const {
+    return paramOffsets.at(index);
+}
+
+int FrameLayout::slotSize(const TypeIdentifier& type, Expression* arraySize) {
+    if(arraySize != nullptr) {
+        auto* lit = dynamic_cast<IntLit*>(arraySize);
+        if(lit == nullptr) {
+            throw std::runtime_error("expected IntLit but found: " + arraySize->toString(0));
+        }
+        return lit->value;
+    }
+    return typeWidth(type);
+}
+
+// Lays out the declarations of one scope, then every nested scope on top of
+// them. Returns the deepest offset used.
+int FrameLayout::layoutScope(const std::vector<Statement*>& statements, int start) {
+    std::vector<Statement*> declarations;
+    for(Statement* stmt : statements) {
+        if(dynamic_cast<VarDeclaration*>(stmt) != nullptr || dynamic_cast<VarDeclAssign*>(stmt) != nullptr) {
+            declarations.push_back(stmt);
+        }
+    }
+
+    auto bytesOf = [](Statement* stmt) {
+        if(auto* decl = dynamic_cast<VarDeclaration*>(stmt)) return slotSize(decl->type, decl->size);
+        return slotSize(dynamic_cast<VarDeclAssign*>(stmt)->type);
+    };
+    std::stable_sort(declarations.begin(), declarations.end(), [&](Statement* a, Statement* b) {
+        return bytesOf(a) > bytesOf(b);
+    });
+
+    for(Statement* stmt : declarations) {
+        auto* decl = dynamic_cast<VarDeclaration*>(stmt);
+        const int bytes = bytesOf(stmt);
+        // arrays get 16 byte alignment so vector code can use aligned accesses
+        const int alignment = decl != nullptr && decl->size != nullptr ? 16 : bytes;
+        start = place(start, bytes, alignment);
+        offsets.insert({stmt, start});
+    }
+
+    int deepest = start;
+    for(Statement* stmt : statements) {
+        deepest = std::max(deepest, layoutNested(stmt, start));
+    }
+    return deepest;
+}
+
+int FrameLayout::layoutNested(Statement* statement, const int start) {
+    if(auto* compound = dynamic_cast<Compound*>(statement)) {
+        return layoutScope(compound->statements, start);
+    }
+    if(auto* stmt = dynamic_cast<If*>(statement)) {
+        return layoutScope({stmt->body}, start);
+    }
+    if(auto* stmt = dynamic_cast<IfElse*>(statement)) {
+        return std::max(layoutScope({stmt->ifBody}, start), layoutScope({stmt->elseBody}, start));
+    }
+    if(auto* stmt = dynamic_cast<While*>(statement)) {
+        return layoutScope({stmt->body}, start);
+    }
+    if(auto* stmt = dynamic_cast<Switch*>(statement)) {
+        int deepest = start;
+        for(const Switch::Case& c : stmt->cases) {
+            deepest = std::max(deepest, layoutScope({c.body}, start));
+        }
+        if(stmt->defaultBody != nullptr) deepest = std::max(deepest, layoutScope({stmt->defaultBody}, start));
+        return deepest;
+    }
+    return start;
+}
+
+bool FrameLayout::callsIn(Statement* statement) {
+    if(auto* stmt = dynamic_cast<Compound*>(statement)) {
+        for(Statement* child : stmt->statements) {
+            if(callsIn(child)) return true;
+        }
+        return false;
+    }
+    if(auto* stmt = dynamic_cast<If*>(statement)) {
+        return callsIn(stmt->condition) || callsIn(stmt->body);
+    }
+    if(auto* stmt = dynamic_cast<IfElse*>(statement)) {
+        return callsIn(stmt->condition) || callsIn(stmt->ifBody) || callsIn(stmt->elseBody);
+    }
+    if(auto* stmt = dynamic_cast<While*>(statement)) {
+        return callsIn(stmt->condition) || callsIn(stmt->body);
+    }
+    if(auto* stmt = dynamic_cast<Switch*>(statement)) {
+        if(callsIn(stmt->value)) return true;
+        for(const Switch::Case& c : stmt->cases) {
+            if(callsIn(c.body)) return true;
+        }
+        return stmt->defaultBody != nullptr && callsIn(stmt->defaultBody);
+    }
+    if(auto* stmt = dynamic_cast<Return*>(statement)) {
+        return stmt->value != nullptr && callsIn(stmt->value);
+    }
+    if(auto* stmt = dynamic_cast<CallStatement*>(statement)) {
+        return isCall(stmt->id.name, stmt->arguments);
+    }
+    if(auto* stmt = dynamic_cast<VarAssignment*>(statement)) {
+        return callsIn(stmt->lhs) || callsIn(stmt->rhs);
+    }
+    if(auto* stmt = dynamic_cast<VarDeclAssign*>(statement)) {
+        return callsIn(stmt->value);
+    }
+    return false;
+}
+
+bool FrameLayout::callsIn(Expression* expr) {
+    if(auto* id = dynamic_cast<IdExpression*>(expr)) {
+        return id->index != nullptr && callsIn(id->index);
+    }
+    if(auto* binary = dynamic_cast<BinaryExpression*>(expr)) {
+        return callsIn(binary->left) || callsIn(binary->right);
+    }
+    if(auto* call = dynamic_cast<CallExpression*>(expr)) {
+        return isCall(call->id.name, call->args);
+    }
+    return false;
+}
+
+bool FrameLayout::isCall(const std::string& name, const std::vector<Expression*>& args) {
+    if(name != "syscall" && !IntrinsicEmitter::isIntrinsic(name)) return true;
+    if(IntrinsicEmitter::makesCall(name)) return true;
+    for(Expression* arg : args) {
+        if(callsIn(arg)) return true;
+    }
+    return false;
+}
+
+int FrameLayout::place(const int start, const int bytes, const int alignment) {
+    const int end = start + bytes;
+    return (end + alignment - 1) / alignment * alignment;
+}
@@ -0,0 +1,41 @@
+#ifndef FRAME_LAYOUT_HPP
+#define FRAME_LAYOUT_HPP
+
+#include <map>
+#include <vector>
+
+#include "AST.hpp"
+
+// Assigns every parameter and local of a function a fixed slot below the
+// frame base. Slots are naturally aligned and packed largest first; locals
+// of sibling scopes share the same space.
+class FrameLayout {
+public:
+    explicit FrameLayout(FunctionDefinition* def);
+
+    // Distance of the slot below the frame base, i.e. the slot is [rbp - offset].
+    [[nodiscard]] int getOffset(const Statement* declaration) const;
+    [[nodiscard]] int getParamOffset(int index) const;
+    // Bytes needed by all slots, not rounded.
+    [[nodiscard]] int getSize() const { return size; }
+    // Leaf functions make no calls; syscalls and intrinsics other than
+    // __builtin_call don't count.
+    [[nodiscard]] bool isLeaf() const { return leaf; }
+
+    static int slotSize(const TypeIdentifier& type, Expression* arraySize = nullptr);
+
+private:
+    int layoutScope(const std::vector<Statement*>& statements, int start);
+    int layoutNested(Statement* statement, int start);
+    static int place(int start, int bytes, int alignment);
+    static bool callsIn(Statement* statement);
+    static bool callsIn(Expression* expr);
+    static bool isCall(const std::string& name, const std::vector<Expression*>& args);
+
+    std::map<const Statement*, int> offsets;
+    std::vector<int> paramOffsets;
+    int size = 0;
+    bool leaf = true;
+};
+
+#endif
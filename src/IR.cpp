@@ -0,0 +1,856 @@
+#include "IR.hpp"
+#include "CallGraph.hpp"
+#include "Intrinsics.hpp"
+#include "Switch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+std::string irOpToString(const IROp op) {
+    switch(op) {
+        case IROp::CONST:       return "const";
+        case IROp::PARAM:       return "param";
+        case IROp::GLOBAL_ADDR: return "global";
+        case IROp::STRING_ADDR: return "string";
+        case IROp::ADD:         return "add";
+        case IROp::SUB:         return "sub";
+        case IROp::MUL:         return "mul";
+        case IROp::DIV:         return "div";
+        case IROp::MOD:         return "mod";
+        case IROp::AND:         return "and";
+        case IROp::OR:          return "or";
+        case IROp::EQ:          return "eq";
+        case IROp::NE:          return "ne";
+        case IROp::LT:          return "lt";
+        case IROp::GT:          return "gt";
+        case IROp::LE:          return "le";
+        case IROp::GE:          return "ge";
+        case IROp::EXTEND:      return "extend";
+        case IROp::LOAD:        return "load";
+        case IROp::STORE:       return "store";
+        case IROp::CALL:        return "call";
+        case IROp::SYSCALL:     return "syscall";
+        case IROp::PHI:         return "phi";
+        case IROp::BR:          return "br";
+        case IROp::COND_BR:     return "condbr";
+        case IROp::SWITCH:      return "switch";
+        case IROp::RET:         return "ret";
+    }
+    return "";
+}
+
+bool isTerminator(const IROp op) {
+    return op == IROp::BR || op == IROp::COND_BR || op == IROp::SWITCH || op == IROp::RET;
+}
+
+bool isComparison(const IROp op) {
+    return op == IROp::EQ || op == IROp::NE || op == IROp::LT || op == IROp::GT || op == IROp::LE || op == IROp::GE;
+}
+
+bool isCommutative(const IROp op) {
+    return op == IROp::ADD || op == IROp::MUL || op == IROp::AND || op == IROp::OR || op == IROp::EQ || op == IROp::NE;
+}
+
+bool hasSideEffects(const IROp op) {
+    return op == IROp::STORE || op == IROp::CALL || op == IROp::SYSCALL || isTerminator(op);
+}
+
+bool IRInstruction::producesValue() const {
+    return op != IROp::STORE && !isTerminator(op);
+}
+
+std::string IRInstruction::toString() const {
+    std::string out;
+    if(producesValue()) {
+        out.append("%" + std::to_string(id) + " = ");
+    }
+    out.append(irOpToString(op));
+    if(op == IROp::LOAD || op == IROp::STORE || op == IROp::EXTEND) {
+        out.append(sign ? ".s" : ".u");
+        out.append(std::to_string(width * 8));
+    }
+    else if(sign) {
+        out.append(".s");
+    }
+
+    switch(op) {
+        case IROp::CONST:
+        case IROp::PARAM:
+            out.append(" " + std::to_string(value));
+            break;
+        case IROp::GLOBAL_ADDR:
+        case IROp::CALL:
+            out.append(" " + symbol);
+            break;
+        case IROp::STRING_ADDR:
+            out.append(" \"" + symbol + "\"");
+            break;
+        default:
+            break;
+    }
+
+    for(size_t i = 0; i < operands.size(); i++) {
+        out.append(i == 0 ? " " : ", ");
+        if(op == IROp::PHI) out.append("[");
+        out.append("%" + std::to_string(operands.at(i)->id));
+        if(op == IROp::PHI) out.append(", " + incoming.at(i)->getName() + "]");
+    }
+    for(size_t i = 0; i < targets.size(); i++) {
+        out.append(i == 0 && operands.empty() ? " " : ", ");
+        if(op == IROp::SWITCH && i > 0) out.append(std::to_string(cases.at(i - 1)) + " -> ");
+        out.append(targets.at(i)->getName());
+    }
+    return out;
+}
+
+IRInstruction* IRBlock::getTerminator() const {
+    if(instructions.empty() || !isTerminator(instructions.back()->op)) return nullptr;
+    return instructions.back();
+}
+
+std::string IRBlock::toString() const {
+    std::string out = getName() + ":";
+    if(!preds.empty()) {
+        out.append("    ; preds:");
+        for(const IRBlock* pred : preds) out.append(" " + pred->getName());
+    }
+    out.append("\n");
+    for(const IRInstruction* inst : instructions) {
+        out.append("  " + inst->toString() + "\n");
+    }
+    return out;
+}
+
+IRBlock* IRFunction::createBlock() {
+    return new IRBlock(nextBlockId++);
+}
+
+void IRFunction::appendBlock(IRBlock* block) {
+    if(std::find(blocks.begin(), blocks.end(), block) == blocks.end()) {
+        blocks.push_back(block);
+    }
+}
+
+IRInstruction* IRFunction::append(IRBlock* block, IRInstruction* inst) {
+    inst->block = block;
+    inst->id = nextValueId++;
+    block->instructions.push_back(inst);
+    return inst;
+}
+
+IRInstruction* IRFunction::insert(IRBlock* block, const size_t index, IRInstruction* inst) {
+    inst->block = block;
+    inst->id = nextValueId++;
+    block->instructions.insert(block->instructions.begin() + static_cast<long>(index), inst);
+    return inst;
+}
+
+void IRFunction::erase(IRInstruction* inst) {
+    auto& list = inst->block->instructions;
+    list.erase(std::remove(list.begin(), list.end(), inst), list.end());
+    inst->block = nullptr;
+}
+
+void IRFunction::replaceAllUsesWith(IRInstruction* from, IRInstruction* to) {
+    for(IRBlock* block : blocks) {
+        for(IRInstruction* inst : block->instructions) {
+            for(IRInstruction*& operand : inst->operands) {
+                if(operand == from) operand = to;
+            }
+        }
+    }
+}
+
+std::vector<IRInstruction*> IRFunction::getUsers(const IRInstruction* inst) const {
+    std::vector<IRInstruction*> users;
+    for(const IRBlock* block : blocks) {
+        for(IRInstruction* user : block->instructions) {
+            if(std::find(user->operands.begin(), user->operands.end(), inst) != user->operands.end()) {
+                users.push_back(user);
+            }
+        }
+    }
+    return users;
+}
+
+void IRFunction::recomputeCFG() {
+    for(IRBlock* block : blocks) {
+        block->preds.clear();
+        block->succs.clear();
+    }
+    for(IRBlock* block : blocks) {
+        const IRInstruction* term = block->getTerminator();
+        if(term == nullptr) continue;
+        for(IRBlock* target : term->targets) {
+            if(std::find(block->succs.begin(), block->succs.end(), target) != block->succs.end()) continue;
+            block->succs.push_back(target);
+            target->preds.push_back(block);
+        }
+    }
+}
+
+bool IRFunction::removeUnreachableBlocks() {
+    recomputeCFG();
+
+    std::set<IRBlock*> reachable;
+    std::vector<IRBlock*> worklist = {blocks.front()};
+    while(!worklist.empty()) {
+        IRBlock* block = worklist.back();
+        worklist.pop_back();
+        if(!reachable.insert(block).second) continue;
+        for(IRBlock* succ : block->succs) worklist.push_back(succ);
+    }
+
+    const size_t before = blocks.size();
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](IRBlock* block) {
+        return !reachable.contains(block);
+    }), blocks.end());
+    bool changed = before != blocks.size();
+
+    recomputeCFG();
+
+    // drop phi operands flowing in over edges that no longer exist
+    for(IRBlock* block : blocks) {
+        std::vector<IRInstruction*> phis;
+        for(IRInstruction* inst : block->instructions) {
+            if(inst->op == IROp::PHI) phis.push_back(inst);
+        }
+        for(IRInstruction* phi : phis) {
+            for(size_t i = phi->operands.size(); i-- > 0;) {
+                IRBlock* pred = phi->incoming.at(i);
+                if(std::find(block->preds.begin(), block->preds.end(), pred) == block->preds.end()) {
+                    phi->operands.erase(phi->operands.begin() + static_cast<long>(i));
+                    phi->incoming.erase(phi->incoming.begin() + static_cast<long>(i));
+                    changed = true;
+                }
+            }
+            if(phi->operands.size() == 1 && phi->operands.front() != phi) {
+                replaceAllUsesWith(phi, phi->operands.front());
+                erase(phi);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+std::vector<IRBlock*> IRFunction::reversePostOrder() const {
+    std::vector<IRBlock*> order;
+    std::set<IRBlock*> visited;
+    std::function<void(IRBlock*)> dfs = [&](IRBlock* block) {
+        if(!visited.insert(block).second) return;
+        for(IRBlock* succ : block->succs) dfs(succ);
+        order.push_back(block);
+    };
+    dfs(blocks.front());
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+std::string IRFunction::toString() const {
+    std::string out = "function " + name + "(";
+    for(size_t i = 0; i < params.size(); i++) {
+        if(i != 0) out.append(", ");
+        out.append("%" + std::to_string(params.at(i)->id));
+    }
+    out.append(")\n");
+    for(const IRBlock* block : blocks) {
+        out.append(block->toString());
+    }
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///                               IRBuilder                                  ///
+////////////////////////////////////////////////////////////////////////////////
+
+IRBuilder::IRBuilder(const std::map<std::string, TypeIdentifier>& globalVars, const std::map<std::string, FunctionDefinition*>& functions) {
+    this->globalVars = globalVars;
+    this->functions = functions;
+}
+
+IRFunction* IRBuilder::lower(FunctionDefinition* def) {
+    def->accept(this);
+    return function;
+}
+
+IRInstruction* IRBuilder::emit(IRInstruction* inst) {
+    for(IRInstruction*& operand : inst->operands) {
+        operand = resolve(operand);
+    }
+    return function->append(block, inst);
+}
+
+IRInstruction* IRBuilder::constant(const long long value) {
+    auto* inst = new IRInstruction(IROp::CONST);
+    inst->value = value;
+    return emit(inst);
+}
+
+IRInstruction* IRBuilder::undef() {
+    // reads of never-assigned variables see 0, the same value CodeGenVisitor
+    // gives a fresh local
+    auto* inst = new IRInstruction(IROp::CONST);
+    IRBlock* entry = function->blocks.front();
+    size_t index = 0;
+    while(index < entry->instructions.size() && entry->instructions.at(index)->op == IROp::PARAM) index++;
+    return function->insert(entry, index, inst);
+}
+
+IRInstruction* IRBuilder::normalize(IRInstruction* value, const TypeIdentifier& type) {
+    const int width = typeWidth(type);
+    if(width == 8) return value;
+
+    auto* inst = new IRInstruction(IROp::EXTEND, {value});
+    inst->width = width;
+    inst->sign = typeSigned(type);
+    return emit(inst);
+}
+
+IRInstruction* IRBuilder::load(IRInstruction* addr, const TypeIdentifier& type) {
+    auto* inst = new IRInstruction(IROp::LOAD, {addr});
+    inst->width = typeWidth(type);
+    inst->sign = typeSigned(type);
+    return emit(inst);
+}
+
+IRBuilder::Operand IRBuilder::evaluate(Expression* expr) {
+    expr->accept(this, 0);
+    Operand operand = operands.top();
+    operands.pop();
+    operand.value = resolve(operand.value);
+    return operand;
+}
+
+IRBuilder::Operand IRBuilder::applyDeref(const Expression* expr, Operand operand) {
+    for(int i = 0; i < expr->derefDepth; i++) {
+        operand.type.ptrDepth--;
+        operand.value = load(operand.value, operand.type);
+        operand.literal = false;
+    }
+    return operand;
+}
+
+IRBuilder::Operand IRBuilder::readNamed(const Identifier& id) {
+    if(const Variable* var = lookup(id.name)) {
+        return Operand{readVariable(var->id, block), var->type};
+    }
+    if(globalVars.contains(id.name)) {
+        const TypeIdentifier type = globalVars.find(id.name)->second;
+        auto* addr = new IRInstruction(IROp::GLOBAL_ADDR);
+        addr->symbol = id.name;
+        emit(addr);
+        // arrays (and every other global with pointer type) evaluate to their address
+        if(type.ptrDepth > 0) return Operand{addr, type};
+        return Operand{load(addr, type), type};
+    }
+    if(functions.contains(id.name)) {
+        // a function named as a value is its address, e.g. for thread_spawn
+        auto* addr = new IRInstruction(IROp::GLOBAL_ADDR);
+        addr->symbol = id.name;
+        return Operand{emit(addr), TypeIdentifier{TypeIdentifierType::U64, 0}};
+    }
+    throw std::runtime_error("can't resolve symbol: \"" + id.name + "\"");
+}
+
+void IRBuilder::visitIntLit(IntLit* expr, int reg) {
+    operands.push(applyDeref(expr, Operand{constant(expr->value), TypeIdentifier{TypeIdentifierType::I64, 0}, true}));
+}
+
+void IRBuilder::visitStringLit(StringLit* expr, int reg) {
+    auto* inst = new IRInstruction(IROp::STRING_ADDR);
+    inst->symbol = expr->value;
+    operands.push(applyDeref(expr, Operand{emit(inst), TypeIdentifier{TypeIdentifierType::CHAR, 1}}));
+}
+
+void IRBuilder::visitCharLit(CharLit* expr, int reg) {
+    operands.push(applyDeref(expr, Operand{constant(static_cast<unsigned char>(expr->value)), TypeIdentifier{TypeIdentifierType::CHAR, 0}, true}));
+}
+
+void IRBuilder::visitIdExpression(IdExpression* expr, int reg) {
+    Operand operand = readNamed(expr->id);
+    if(expr->index != nullptr) {
+        const Operand index = evaluate(expr->index);
+        auto* addr = emit(new IRInstruction(IROp::ADD, {operand.value, index.value}));
+        operand.type.ptrDepth--;
+        operand.value = load(addr, operand.type);
+    }
+    operands.push(applyDeref(expr, operand));
+}
+
+void IRBuilder::visitBinaryExpression(BinaryExpression* expr, int reg) {
+    if(expr->op == BinaryOperator::LOGIC_AND || expr->op == BinaryOperator::LOGIC_OR) {
+        // the result is a phi of 1 and 0 over the short-circuit branches
+        IRBlock* isTrue = function->createBlock();
+        IRBlock* isFalse = function->createBlock();
+        IRBlock* join = function->createBlock();
+        branchOn(expr, isTrue, isFalse);
+        seal(isTrue);
+        seal(isFalse);
+
+        const int var = nextVariable++;
+        setBlock(isTrue);
+        writeVariable(var, isTrue, constant(1));
+        branch(join);
+        setBlock(isFalse);
+        writeVariable(var, isFalse, constant(0));
+        branch(join);
+        seal(join);
+
+        setBlock(join);
+        operands.push(applyDeref(expr, Operand{readVariable(var, join), TypeIdentifier{TypeIdentifierType::BOOL, 0}}));
+        return;
+    }
+
+    const Operand left = evaluate(expr->left);
+    const Operand right = evaluate(expr->right);
+
+    IROp op = IROp::ADD;
+    switch(expr->op) {
+        case BinaryOperator::PLUS:      op = IROp::ADD; break;
+        case BinaryOperator::MINUS:     op = IROp::SUB; break;
+        case BinaryOperator::MUL:       op = IROp::MUL; break;
+        case BinaryOperator::DIV:       op = IROp::DIV; break;
+        case BinaryOperator::MOD:       op = IROp::MOD; break;
+        case BinaryOperator::BIT_AND:   op = IROp::AND; break;
+        case BinaryOperator::BIT_OR:    op = IROp::OR; break;
+        case BinaryOperator::EQUALS:    op = IROp::EQ; break;
+        case BinaryOperator::NEQUALS:   op = IROp::NE; break;
+        case BinaryOperator::LESS:      op = IROp::LT; break;
+        case BinaryOperator::GREATER:   op = IROp::GT; break;
+        case BinaryOperator::LEQUALS:   op = IROp::LE; break;
+        case BinaryOperator::GEQUALS:   op = IROp::GE; break;
+        case BinaryOperator::LOGIC_AND:
+        case BinaryOperator::LOGIC_OR:  break;
+    }
+
+    auto* inst = new IRInstruction(op, {left.value, right.value});
+    // literals adopt the signedness of the other side
+    inst->sign = (left.literal || typeSigned(left.type)) && (right.literal || typeSigned(right.type));
+
+    Operand result{emit(inst), left.literal ? right.type : left.type, left.literal && right.literal};
+    if(isComparison(op)) {
+        result.type = TypeIdentifier{TypeIdentifierType::BOOL, 0};
+        result.literal = false;
+    }
+    else if(result.type.ptrDepth == 0 && typeWidth(result.type) != 8) {
+        result.value = normalize(result.value, result.type);
+    }
+    operands.push(applyDeref(expr, result));
+}
+
+IRInstruction* IRBuilder::call(const std::string& name, const std::vector<Expression*>& args, TypeIdentifier& returnType) {
+    std::vector<IRInstruction*> values;
+    for(Expression* arg : args) {
+        values.push_back(evaluate(arg).value);
+    }
+
+    if(name == "syscall") {
+        returnType = TypeIdentifier{TypeIdentifierType::I64, 0};
+        return emit(new IRInstruction(IROp::SYSCALL, values));
+    }
+
+    if(IntrinsicEmitter::isIntrinsic(name)) {
+        if(args.size() != IntrinsicEmitter::argumentCount(name)) {
+            throw std::runtime_error(name + " expects " + std::to_string(IntrinsicEmitter::argumentCount(name)) + " arguments");
+        }
+        returnType = IntrinsicEmitter::returnType(name);
+    } else if(functions.contains(name)) {
+        returnType = functions.find(name)->second->returnType;
+    } else {
+        throw std::runtime_error("can't resolve function: \"" + name + "\"");
+    }
+
+    auto* inst = new IRInstruction(IROp::CALL, values);
+    inst->symbol = name;
+    return emit(inst);
+}
+
+void IRBuilder::visitCallExpression(CallExpression* expr, int reg) {
+    TypeIdentifier type{};
+    IRInstruction* value = call(expr->id.name, expr->args, type);
+    operands.push(applyDeref(expr, Operand{normalize(value, type), type}));
+}
+
+void IRBuilder::visitCompound(Compound* stmt) {
+    scopes.emplace_back();
+}
+
+void IRBuilder::visitEndCompound(EndCompound* stmt) {
+    scopes.pop_back();
+}
+
+void IRBuilder::visitIf(If* stmt) {
+    IRBlock* body = function->createBlock();
+    IRBlock* end = function->createBlock();
+
+    branchOn(stmt->condition, body, end);
+    seal(body);
+
+    setBlock(body);
+    const size_t first = function->blocks.size() - 1;
+    stmt->body->accept(this);
+    if(CallGraph::isCold(stmt->body, functions)) {
+        for(size_t i = first; i < function->blocks.size(); i++) {
+            function->blocks.at(i)->cold = true;
+        }
+    }
+    branch(end);
+    seal(end);
+
+    setBlock(end);
+}
+
+void IRBuilder::visitIfElse(IfElse* stmt) {
+    IRBlock* ifBody = function->createBlock();
+    IRBlock* elseBody = function->createBlock();
+    IRBlock* end = function->createBlock();
+
+    branchOn(stmt->condition, ifBody, elseBody);
+    seal(ifBody);
+    seal(elseBody);
+
+    setBlock(ifBody);
+    stmt->ifBody->accept(this);
+    branch(end);
+
+    setBlock(elseBody);
+    stmt->elseBody->accept(this);
+    branch(end);
+    seal(end);
+
+    setBlock(end);
+}
+
+void IRBuilder::visitWhile(While* stmt) {
+    IRBlock* header = function->createBlock();
+    IRBlock* body = function->createBlock();
+    IRBlock* exit = function->createBlock();
+
+    branch(header);
+    setBlock(header);
+    branchOn(stmt->condition, body, exit);
+    seal(body);
+    seal(exit);
+
+    setBlock(body);
+    stmt->body->accept(this);
+    branch(header);
+    seal(header);
+
+    setBlock(exit);
+}
+
+void IRBuilder::visitSwitch(Switch* stmt) {
+    const Operand value = evaluate(stmt->value);
+
+    auto* sw = new IRInstruction(IROp::SWITCH, {value.value});
+    sw->sign = typeSigned(value.type);
+    const int width = typeWidth(value.type);
+
+    std::vector<IRBlock*> bodies;
+    for(size_t i = 0; i < stmt->cases.size(); i++) {
+        bodies.push_back(function->createBlock());
+    }
+    IRBlock* defaultBody = stmt->defaultBody != nullptr ? function->createBlock() : nullptr;
+    IRBlock* end = function->createBlock();
+    IRBlock* fallback = defaultBody != nullptr ? defaultBody : end;
+
+    sw->targets.push_back(fallback);
+    // case values wrap like the normalized switch value does
+    const std::vector<long long> values = SwitchEmitter::wrapCases(stmt, width, sw->sign);
+    size_t next = 0;
+    for(size_t i = 0; i < stmt->cases.size(); i++) {
+        for(size_t k = 0; k < stmt->cases.at(i).values.size(); k++) {
+            sw->cases.push_back(values.at(next++));
+            sw->targets.push_back(bodies.at(i));
+        }
+    }
+    emit(sw);
+    for(IRBlock* target : sw->targets) {
+        if(std::find(block->succs.begin(), block->succs.end(), target) != block->succs.end()) continue;
+        block->succs.push_back(target);
+        target->preds.push_back(block);
+    }
+    for(IRBlock* body : bodies) seal(body);
+    if(defaultBody != nullptr) seal(defaultBody);
+
+    for(size_t i = 0; i < stmt->cases.size(); i++) {
+        setBlock(bodies.at(i));
+        stmt->cases.at(i).body->accept(this);
+        branch(end);
+    }
+    if(defaultBody != nullptr) {
+        setBlock(defaultBody);
+        stmt->defaultBody->accept(this);
+        branch(end);
+    }
+    seal(end);
+    setBlock(end);
+}
+
+void IRBuilder::visitReturn(Return* stmt) {
+    auto* ret = new IRInstruction(IROp::RET);
+    if(stmt->value != nullptr && (definition->returnType.type != TypeIdentifierType::VOID || definition->returnType.ptrDepth > 0)) {
+        const Operand value = evaluate(stmt->value);
+        ret->operands.push_back(normalize(value.value, definition->returnType));
+    }
+    emit(ret);
+
+    // anything after a return is unreachable; keep lowering it into a
+    // block without predecessors so DCE can drop it
+    IRBlock* dead = function->createBlock();
+    setBlock(dead);
+    seal(dead);
+}
+
+void IRBuilder::visitCallStatement(CallStatement* stmt) {
+    TypeIdentifier type{};
+    call(stmt->id.name, stmt->arguments, type);
+}
+
+void IRBuilder::assign(Expression* lhs, const Operand value) {
+    auto* id = dynamic_cast<IdExpression*>(lhs);
+
+    if(id != nullptr && id->index == nullptr && id->derefDepth == 0) {
+        if(const Variable* var = lookup(id->id.name)) {
+            writeVariable(var->id, block, normalize(value.value, var->type));
+            return;
+        }
+        if(globalVars.contains(id->id.name)) {
+            auto* addr = new IRInstruction(IROp::GLOBAL_ADDR);
+            addr->symbol = id->id.name;
+            emit(addr);
+            auto* store = new IRInstruction(IROp::STORE, {addr, value.value});
+            store->width = typeWidth(globalVars.find(id->id.name)->second);
+            emit(store);
+            return;
+        }
+        throw std::runtime_error("can't resolve symbol: \"" + id->id.name + "\"");
+    }
+
+    // compute the address that is written: for x[i] the element address,
+    // for *e the value of e
+    Operand addr{};
+    if(lhs->derefDepth > 0) {
+        lhs->derefDepth--;
+        addr = evaluate(lhs);
+        lhs->derefDepth++;
+    }
+    else if(id != nullptr) {
+        addr = readNamed(id->id);
+        const Operand index = evaluate(id->index);
+        addr.value = emit(new IRInstruction(IROp::ADD, {addr.value, index.value}));
+    }
+    else {
+        throw std::runtime_error("invalid assignment target: " + lhs->toString(0));
+    }
+    addr.type.ptrDepth--;
+
+    auto* store = new IRInstruction(IROp::STORE, {addr.value, value.value});
+    store->width = typeWidth(addr.type);
+    emit(store);
+}
+
+void IRBuilder::visitVarAssignment(VarAssignment* stmt) {
+    const Operand value = evaluate(stmt->rhs);
+    assign(stmt->lhs, value);
+}
+
+void IRBuilder::visitVarDeclaration(VarDeclaration* stmt) {
+    const Variable* var = declare(stmt->id.name, stmt->type);
+    writeVariable(var->id, block, constant(0));
+}
+
+void IRBuilder::visitVarDeclAssign(VarDeclAssign* stmt) {
+    const Operand value = evaluate(stmt->value);
+    const Variable* var = declare(stmt->id.name, stmt->type);
+    writeVariable(var->id, block, normalize(value.value, stmt->type));
+}
+
+void IRBuilder::visitFunctionDefinition(FunctionDefinition* def) {
+    definition = def;
+    function = new IRFunction(def->id.name);
+    function->returnsValue = def->returnType.type != TypeIdentifierType::VOID || def->returnType.ptrDepth > 0;
+
+    scopes.clear();
+    scopes.emplace_back();
+    currentDef.clear();
+    incompletePhis.clear();
+    sealedBlocks.clear();
+    replaced.clear();
+    nextVariable = 0;
+
+    IRBlock* entry = function->createBlock();
+    setBlock(entry);
+    seal(entry);
+
+    for(const auto& param : def->args) {
+        auto* inst = new IRInstruction(IROp::PARAM);
+        inst->value = param.index;
+        function->params.push_back(emit(inst));
+
+        const Variable* var = declare(param.name, param.type);
+        writeVariable(var->id, block, normalize(inst, param.type));
+    }
+
+    def->body->accept(this);
+
+    // falling off the end of the function returns
+    if(block->getTerminator() == nullptr) {
+        auto* ret = new IRInstruction(IROp::RET);
+        if(function->returnsValue) ret->operands.push_back(constant(0));
+        emit(ret);
+    }
+
+    function->removeUnreachableBlocks();
+}
+
+void IRBuilder::visitProgram(Program* prog) {}
+
+void IRBuilder::branch(IRBlock* target) {
+    auto* br = new IRInstruction(IROp::BR);
+    br->targets = {target};
+    emit(br);
+    block->succs.push_back(target);
+    target->preds.push_back(block);
+}
+
+void IRBuilder::condBranch(IRInstruction* cond, IRBlock* ifTrue, IRBlock* ifFalse) {
+    auto* br = new IRInstruction(IROp::COND_BR, {cond});
+    br->targets = {ifTrue, ifFalse};
+    emit(br);
+    block->succs = {ifTrue, ifFalse};
+    ifTrue->preds.push_back(block);
+    ifFalse->preds.push_back(block);
+}
+
+// Branches on cond; && and || get a block for their right operand that is
+// only entered if the left one doesn't decide the result.
+void IRBuilder::branchOn(Expression* cond, IRBlock* ifTrue, IRBlock* ifFalse) {
+    auto* binary = dynamic_cast<BinaryExpression*>(cond);
+    if(binary == nullptr || binary->derefDepth != 0 ||
+        (binary->op != BinaryOperator::LOGIC_AND && binary->op != BinaryOperator::LOGIC_OR)) {
+        condBranch(evaluate(cond).value, ifTrue, ifFalse);
+        return;
+    }
+
+    IRBlock* right = function->createBlock();
+    if(binary->op == BinaryOperator::LOGIC_AND) branchOn(binary->left, right, ifFalse);
+    else branchOn(binary->left, ifTrue, right);
+    seal(right);
+
+    setBlock(right);
+    branchOn(binary->right, ifTrue, ifFalse);
+}
+
+void IRBuilder::setBlock(IRBlock* block) {
+    this->block = block;
+    function->appendBlock(block);
+}
+
+void IRBuilder::seal(IRBlock* block) {
+    if(incompletePhis.contains(block)) {
+        const auto phis = incompletePhis.find(block)->second;
+        incompletePhis.erase(block);
+        for(const auto& [var, phi] : phis) {
+            addPhiOperands(var, phi);
+        }
+    }
+    sealedBlocks.insert(block);
+}
+
+IRBuilder::Variable* IRBuilder::lookup(const std::string& name) {
+    for(auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        if(scope->contains(name)) return &scope->find(name)->second;
+    }
+    return nullptr;
+}
+
+IRBuilder::Variable* IRBuilder::declare(const std::string& name, const TypeIdentifier& type) {
+    scopes.back()[name] = Variable{nextVariable++, type};
+    return &scopes.back().find(name)->second;
+}
+
+void IRBuilder::writeVariable(const int var, IRBlock* block, IRInstruction* value) {
+    currentDef[var][block] = value;
+}
+
+IRInstruction* IRBuilder::readVariable(const int var, IRBlock* block) {
+    if(currentDef.contains(var) && currentDef[var].contains(block)) {
+        return resolve(currentDef[var][block]);
+    }
+    return readVariableRecursive(var, block);
+}
+
+IRInstruction* IRBuilder::readVariableRecursive(const int var, IRBlock* block) {
+    IRInstruction* value;
+    if(!sealedBlocks.contains(block)) {
+        auto* phi = new IRInstruction(IROp::PHI);
+        function->insert(block, 0, phi);
+        incompletePhis[block][var] = phi;
+        value = phi;
+    }
+    else if(block->preds.empty()) {
+        value = undef();
+    }
+    else if(block->preds.size() == 1) {
+        value = readVariable(var, block->preds.front());
+    }
+    else {
+        auto* phi = new IRInstruction(IROp::PHI);
+        function->insert(block, 0, phi);
+        writeVariable(var, block, phi);
+        value = addPhiOperands(var, phi);
+    }
+    writeVariable(var, block, value);
+    return value;
+}
+
+IRInstruction* IRBuilder::addPhiOperands(const int var, IRInstruction* phi) {
+    for(IRBlock* pred : phi->block->preds) {
+        phi->operands.push_back(readVariable(var, pred));
+        phi->incoming.push_back(pred);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+IRInstruction* IRBuilder::tryRemoveTrivialPhi(IRInstruction* phi) {
+    IRInstruction* same = nullptr;
+    for(IRInstruction* operand : phi->operands) {
+        operand = resolve(operand);
+        if(operand == same || operand == phi) continue;
+        if(same != nullptr) return phi;
+        same = operand;
+    }
+    if(same == nullptr) same = undef();
+
+    std::vector<IRInstruction*> users = function->getUsers(phi);
+    function->replaceAllUsesWith(phi, same);
+    function->erase(phi);
+    replaced[phi] = same;
+    for(auto& [var, defs] : currentDef) {
+        for(auto& [defBlock, value] : defs) {
+            if(value == phi) value = same;
+        }
+    }
+
+    for(IRInstruction* user : users) {
+        // phis of unsealed blocks are still missing operands
+        if(user != phi && user->op == IROp::PHI && user->block != nullptr && sealedBlocks.contains(user->block)) {
+            tryRemoveTrivialPhi(user);
+        }
+    }
+    return same;
+}
+
+IRInstruction* IRBuilder::resolve(IRInstruction* value) const {
+    while(replaced.contains(value)) {
+        value = replaced.find(value)->second;
+    }
+    return value;
+}
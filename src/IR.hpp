@@ -0,0 +1,223 @@
+#ifndef IR_HPP
+#define IR_HPP
+
+#include <map>
+#include <set>
+#include <stack>
+#include <string>
+#include <vector>
+
+#include "AST.hpp"
+
+enum class IROp {
+    CONST, PARAM, GLOBAL_ADDR, STRING_ADDR,
+    ADD, SUB, MUL, DIV, MOD, AND, OR,
+    EQ, NE, LT, GT, LE, GE,
+    EXTEND, LOAD, STORE, CALL, SYSCALL, PHI,
+    BR, COND_BR, SWITCH, RET
+};
+
+std::string irOpToString(IROp op);
+bool isTerminator(IROp op);
+bool isComparison(IROp op);
+bool isCommutative(IROp op);
+bool hasSideEffects(IROp op);
+
+// width in bytes of a value of the given type as it is kept in memory
+inline int typeWidth(const TypeIdentifier& type) {
+    if(type.ptrDepth > 0) return 8;
+    switch(type.type) {
+        case TypeIdentifierType::I8:
+        case TypeIdentifierType::U8:
+        case TypeIdentifierType::CHAR:
+        case TypeIdentifierType::BOOL:
+            return 1;
+        case TypeIdentifierType::I16:
+        case TypeIdentifierType::U16:
+            return 2;
+        case TypeIdentifierType::I32:
+        case TypeIdentifierType::U32:
+        case TypeIdentifierType::F32:
+            return 4;
+        default:
+            return 8;
+    }
+}
+
+inline bool typeSigned(const TypeIdentifier& type) {
+    if(type.ptrDepth > 0) return false;
+    switch(type.type) {
+        case TypeIdentifierType::I8:
+        case TypeIdentifierType::I16:
+        case TypeIdentifierType::I32:
+        case TypeIdentifierType::I64:
+            return true;
+        default:
+            return false;
+    }
+}
+
+class IRBlock;
+
+// A single SSA instruction. Every instruction that produces a value is
+// its own value; operands point directly at the defining instructions.
+class IRInstruction {
+public:
+    explicit IRInstruction(const IROp op, const std::vector<IRInstruction*>& operands = {}) {
+        this->op = op;
+        this->operands = operands;
+    }
+
+    [[nodiscard]] bool producesValue() const;
+    [[nodiscard]] std::string toString() const;
+
+    IROp op;
+    int id = -1;
+    std::vector<IRInstruction*> operands;
+    std::vector<IRBlock*> incoming;     // PHI: predecessor for each operand
+    std::vector<IRBlock*> targets;      // BR: {target}, COND_BR: {true, false}, SWITCH: {default, case targets...}
+    std::vector<long long> cases;       // SWITCH: value of each case target
+    long long value = 0;                // CONST: value, PARAM: index
+    std::string symbol;                 // GLOBAL_ADDR, STRING_ADDR, CALL
+    int width = 8;                      // LOAD, STORE, EXTEND
+    bool sign = false;                  // DIV, MOD, comparisons, LOAD, EXTEND
+    IRBlock* block = nullptr;
+};
+
+class IRBlock {
+public:
+    explicit IRBlock(const int id) {
+        this->id = id;
+    }
+
+    [[nodiscard]] IRInstruction* getTerminator() const;
+    [[nodiscard]] std::string getName() const { return "B" + std::to_string(id); }
+    [[nodiscard]] std::string toString() const;
+
+    int id;
+    std::vector<IRInstruction*> instructions;
+    std::vector<IRBlock*> preds;
+    std::vector<IRBlock*> succs;
+    bool cold = false;      // error path, laid out behind everything else
+};
+
+class IRFunction {
+public:
+    explicit IRFunction(const std::string& name) {
+        this->name = name;
+    }
+
+    IRBlock* createBlock();
+    void appendBlock(IRBlock* block);
+    IRInstruction* append(IRBlock* block, IRInstruction* inst);
+    IRInstruction* insert(IRBlock* block, size_t index, IRInstruction* inst);
+    void erase(IRInstruction* inst);
+
+    void replaceAllUsesWith(IRInstruction* from, IRInstruction* to);
+    [[nodiscard]] std::vector<IRInstruction*> getUsers(const IRInstruction* inst) const;
+
+    void recomputeCFG();
+    bool removeUnreachableBlocks();
+    [[nodiscard]] std::vector<IRBlock*> reversePostOrder() const;
+
+    [[nodiscard]] std::string toString() const;
+
+    std::string name;
+    std::vector<IRBlock*> blocks;   // blocks[0] is the entry block
+    std::vector<IRInstruction*> params;
+    bool returnsValue = false;
+
+private:
+    int nextBlockId = 0;
+    int nextValueId = 0;
+};
+
+// Lowers a FunctionDefinition body into SSA form. Variables are renamed
+// on the fly while the AST is walked (Braun et al., "Simple and Efficient
+// Construction of Static Single Assignment Form"), so no separate
+// dominance-frontier phase is needed.
+class IRBuilder final : public Visitor {
+public:
+    IRBuilder(const std::map<std::string, TypeIdentifier>& globalVars, const std::map<std::string, FunctionDefinition*>& functions);
+
+    IRFunction* lower(FunctionDefinition* def);
+
+    void visitIntLit(IntLit* expr, int reg) override;
+    void visitStringLit(StringLit* expr, int reg) override;
+    void visitCharLit(CharLit* expr, int reg) override;
+    void visitIdExpression(IdExpression* expr, int reg) override;
+    void visitBinaryExpression(BinaryExpression* expr, int reg) override;
+    void visitCallExpression(CallExpression* expr, int reg) override;
+
+    void visitCompound(Compound* stmt) override;
+    void visitEndCompound(EndCompound* stmt) override;
+    void visitIf(If* stmt) override;
+    void visitIfElse(IfElse* stmt) override;
+    void visitReturn(Return* stmt) override;
+    void visitCallStatement(CallStatement* stmt) override;
+    void visitVarAssignment(VarAssignment* stmt) override;
+    void visitVarDeclaration(VarDeclaration* stmt) override;
+    void visitVarDeclAssign(VarDeclAssign* stmt) override;
+    void visitWhile(While* stmt) override;
+    void visitSwitch(Switch* stmt) override;
+
+    void visitFunctionDefinition(FunctionDefinition* def) override;
+    void visitProgram(Program* prog) override;
+
+private:
+    struct Operand {
+        IRInstruction* value;
+        TypeIdentifier type;
+        bool literal = false;
+    };
+
+    struct Variable {
+        int id;
+        TypeIdentifier type;
+    };
+
+    IRInstruction* emit(IRInstruction* inst);
+    IRInstruction* constant(long long value);
+    IRInstruction* undef();
+    IRInstruction* normalize(IRInstruction* value, const TypeIdentifier& type);
+    IRInstruction* load(IRInstruction* addr, const TypeIdentifier& type);
+
+    Operand evaluate(Expression* expr);
+    Operand applyDeref(const Expression* expr, Operand operand);
+    Operand readNamed(const Identifier& id);
+    void assign(Expression* lhs, Operand value);
+    IRInstruction* call(const std::string& name, const std::vector<Expression*>& args, TypeIdentifier& returnType);
+
+    void branch(IRBlock* target);
+    void condBranch(IRInstruction* cond, IRBlock* ifTrue, IRBlock* ifFalse);
+    void branchOn(Expression* cond, IRBlock* ifTrue, IRBlock* ifFalse);
+    void setBlock(IRBlock* block);
+    void seal(IRBlock* block);
+
+    Variable* lookup(const std::string& name);
+    Variable* declare(const std::string& name, const TypeIdentifier& type);
+
+    void writeVariable(int var, IRBlock* block, IRInstruction* value);
+    IRInstruction* readVariable(int var, IRBlock* block);
+    IRInstruction* readVariableRecursive(int var, IRBlock* block);
+    IRInstruction* addPhiOperands(int var, IRInstruction* phi);
+    IRInstruction* tryRemoveTrivialPhi(IRInstruction* phi);
+    IRInstruction* resolve(IRInstruction* value) const;
+
+    std::map<std::string, TypeIdentifier> globalVars;
+    std::map<std::string, FunctionDefinition*> functions;
+
+    std::vector<std::map<std::string, Variable>> scopes;
+    std::map<int, std::map<IRBlock*, IRInstruction*>> currentDef;
+    std::map<IRBlock*, std::map<int, IRInstruction*>> incompletePhis;
+    std::set<IRBlock*> sealedBlocks;
+    std::map<IRInstruction*, IRInstruction*> replaced;
+    std::stack<Operand> operands;
+
+    IRFunction* function = nullptr;
+    IRBlock* block = nullptr;
+    FunctionDefinition* definition = nullptr;
+    int nextVariable = 0;
+};
+
+#endif
@@ -0,0 +1,486 @@
+#include "InstructionSelector.hpp"
+#include "Intrinsics.hpp"
+#include "LinearScan.hpp"
+#include "Switch.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+const std::string ARG_REGS[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+const std::string SYSCALL_REGS[] = {"rax", "rdi", "rsi", "rdx", "r10", "r8", "r9"};
+const std::string CALLEE_SAVED[] = {"rbx", "r12", "r13", "r14", "r15"};
+// no argument registers, so parameters can't be overwritten before they're read
+const std::string SCRATCH_REGS[] = {"r10", "r11"};
+
+static std::string conditionCode(const IROp op, const bool sign) {
+    switch(op) {
+        case IROp::EQ: return "e";
+        case IROp::NE: return "ne";
+        case IROp::LT: return sign ? "l" : "b";
+        case IROp::GT: return sign ? "g" : "a";
+        case IROp::LE: return sign ? "le" : "be";
+        case IROp::GE: return sign ? "ge" : "ae";
+        default: return "";
+    }
+}
+
+static std::string invertCondition(const std::string& cc) {
+    if(cc == "e") return "ne";
+    if(cc == "ne") return "e";
+    if(cc == "l") return "ge";
+    if(cc == "ge") return "l";
+    if(cc == "g") return "le";
+    if(cc == "le") return "g";
+    if(cc == "b") return "ae";
+    if(cc == "ae") return "b";
+    if(cc == "a") return "be";
+    return "a";
+}
+
+static std::string sizedReg(const std::string& reg, const int width) {
+    if(reg == "rax") return width == 1 ? "al" : width == 2 ? "ax" : width == 4 ? "eax" : "rax";
+    if(reg == "rcx") return width == 1 ? "cl" : width == 2 ? "cx" : width == 4 ? "ecx" : "rcx";
+    if(reg == "rdx") return width == 1 ? "dl" : width == 2 ? "dx" : width == 4 ? "edx" : "rdx";
+    throw std::runtime_error("no sized form for register " + reg);
+}
+
+static std::string sizePrefix(const int width) {
+    return width == 1 ? "byte" : width == 2 ? "word" : width == 4 ? "dword" : "qword";
+}
+
+// bytes below rsp that signal handlers leave alone (System V ABI)
+const int RED_ZONE = 128;
+
+static bool fitsImmediate(const long long value) {
+    return value >= INT_MIN && value <= INT_MAX;
+}
+
+InstructionSelector::InstructionSelector(std::vector<OpCode*>& textSegment, std::vector<OpCode*>& roSegment, StringPool& strings, const int vectorBytes, const bool omitFramePointer)
+    : textSegment(textSegment), roSegment(roSegment), strings(strings), omitFramePointer(omitFramePointer), vectorBytes(vectorBytes) {}
+
+void InstructionSelector::select(IRFunction* function) {
+    this->function = function;
+    slots.clear();
+    phiSlots.clear();
+    registers.clear();
+    phiRegisters.clear();
+    saved.clear();
+    fused.clear();
+    function->recomputeCFG();
+
+    // cold blocks go last; a block reached from itself or a block behind it
+    // in source order is a loop head and gets aligned
+    const std::vector<IRBlock*>& blocks = function->blocks;
+    std::vector<IRBlock*> order;
+    std::copy_if(function->blocks.begin(), function->blocks.end(), std::back_inserter(order), [](IRBlock* b) { return !b->cold; });
+    std::copy_if(function->blocks.begin(), function->blocks.end(), std::back_inserter(order), [](IRBlock* b) { return b->cold; });
+
+    assignLocations(order);
+    frameless = omitFramePointer && frameSize <= RED_ZONE && isLeaf();
+
+    textSegment.push_back(new Label(function->name));
+    if(!frameless) {
+        textSegment.push_back(new Push("rbp"));
+        textSegment.push_back(new Move("rbp", "rsp"));
+        if(frameSize != 0) {
+            textSegment.push_back(new Sub("rsp", std::to_string(frameSize)));
+        }
+    }
+    for(const auto& [reg, index] : saved) {
+        textSegment.push_back(new Move(slot(index), reg));
+    }
+
+    for(size_t i = 0; i < order.size(); i++) {
+        IRBlock* block = order.at(i);
+        IRBlock* next = i + 1 < order.size() ? order.at(i + 1) : nullptr;
+        const bool loopHead = std::any_of(block->preds.begin(), block->preds.end(), [&](IRBlock* pred) {
+            return std::find(blocks.begin(), blocks.end(), pred) >= std::find(blocks.begin(), blocks.end(), block);
+        });
+        if(loopHead && i != 0) textSegment.push_back(new Align(CODE_ALIGNMENT));
+        selectBlock(block, next);
+    }
+}
+
+void InstructionSelector::assignLocations(const std::vector<IRBlock*>& order) {
+    std::vector<IRInstruction*> values;
+    for(IRBlock* block : function->blocks) {
+        IRInstruction* term = block->getTerminator();
+        for(IRInstruction* inst : block->instructions) {
+            if(!inst->producesValue()) continue;
+            if(inst->op == IROp::CONST || inst->op == IROp::GLOBAL_ADDR || inst->op == IROp::STRING_ADDR) continue;
+
+            // a compare only feeding the branch of its own block is folded
+            // into a cmp/jcc pair and never materialized
+            if(isComparison(inst->op) && term != nullptr && term->op == IROp::COND_BR && term->operands.front() == inst) {
+                const std::vector<IRInstruction*> users = function->getUsers(inst);
+                if(users.size() == 1) {
+                    fused.insert(inst);
+                    continue;
+                }
+            }
+
+            values.push_back(inst);
+        }
+    }
+
+    std::vector<std::string> pool;
+    if(!entersKernelOrCalls()) pool.assign(std::begin(SCRATCH_REGS), std::end(SCRATCH_REGS));
+    pool.insert(pool.end(), std::begin(CALLEE_SAVED), std::end(CALLEE_SAVED));
+    LinearScan scan(order, values, fused);
+    scan.assign(pool);
+
+    int count = 0;
+    for(const std::string& reg : scan.getUsed()) {
+        if(std::find(std::begin(CALLEE_SAVED), std::end(CALLEE_SAVED), reg) != std::end(CALLEE_SAVED)) {
+            saved.emplace_back(reg, count++);
+        }
+    }
+    for(IRInstruction* value : values) {
+        const std::string reg = scan.getRegister(value);
+        if(!reg.empty()) registers[value] = reg;
+        else slots[value] = count++;
+        // phis get a second place their predecessors write into, so all
+        // phis of a block are updated as one parallel copy
+        if(value->op != IROp::PHI) continue;
+        const std::string copyReg = scan.getCopyRegister(value);
+        if(!copyReg.empty()) phiRegisters[value] = copyReg;
+        else phiSlots[value] = count++;
+    }
+    frameSize = count * 8;
+    if(frameSize % 16 != 0) frameSize += 8;
+}
+
+bool InstructionSelector::isLeaf() const {
+    for(IRBlock* block : function->blocks) {
+        for(IRInstruction* inst : block->instructions) {
+            if(inst->op != IROp::CALL) continue;
+            if(!IntrinsicEmitter::isIntrinsic(inst->symbol) || IntrinsicEmitter::makesCall(inst->symbol)) return false;
+        }
+    }
+    return true;
+}
+
+// r10 and r11 are clobbered by syscall and by the code of intrinsics
+bool InstructionSelector::entersKernelOrCalls() const {
+    for(IRBlock* block : function->blocks) {
+        for(IRInstruction* inst : block->instructions) {
+            if(inst->op == IROp::CALL || inst->op == IROp::SYSCALL) return true;
+        }
+    }
+    return false;
+}
+
+std::string InstructionSelector::slot(const int index) const {
+    return (frameless ? "qword [rsp - " : "qword [rbp - ") + std::to_string((index + 1) * 8) + "]";
+}
+
+std::string InstructionSelector::label(const IRBlock* block) const {
+    return function->name + localLabel(block);
+}
+
+std::string InstructionSelector::localLabel(const IRBlock* block) const {
+    return "." + block->getName();
+}
+
+void InstructionSelector::load(const std::string& reg, IRInstruction* value) {
+    switch(value->op) {
+        case IROp::CONST:
+            if(value->value == 0) textSegment.push_back(new XOR(reg, reg));
+            else textSegment.push_back(new Move(reg, std::to_string(value->value)));
+            break;
+        case IROp::GLOBAL_ADDR:
+            textSegment.push_back(new Move(reg, value->symbol));
+            break;
+        case IROp::STRING_ADDR:
+            textSegment.push_back(new Move(reg, strings.intern(value->symbol)));
+            break;
+        default:
+            copy(reg, location(value));
+            break;
+    }
+}
+
+std::string InstructionSelector::location(IRInstruction* value) const {
+    const auto reg = registers.find(value);
+    if(reg != registers.end()) return reg->second;
+    const auto index = slots.find(value);
+    if(index == slots.end()) {
+        throw std::runtime_error("value %" + std::to_string(value->id) + " has no register or stack slot");
+    }
+    return slot(index->second);
+}
+
+std::string InstructionSelector::phiLocation(IRInstruction* phi) const {
+    const auto reg = phiRegisters.find(phi);
+    if(reg != phiRegisters.end()) return reg->second;
+    return slot(phiSlots.find(phi)->second);
+}
+
+// The register a value is computed in: its own, or rax to be stored.
+std::string InstructionSelector::target(IRInstruction* value) const {
+    const auto reg = registers.find(value);
+    return reg != registers.end() ? reg->second : "rax";
+}
+
+std::string InstructionSelector::operand(IRInstruction* value, const std::string& reg) {
+    if(value->op == IROp::CONST && fitsImmediate(value->value)) {
+        return std::to_string(value->value);
+    }
+    return inRegister(value, reg);
+}
+
+// The register holding value, loading it into reg if it has none.
+std::string InstructionSelector::inRegister(IRInstruction* value, const std::string& reg) {
+    const auto found = registers.find(value);
+    if(found != registers.end()) return found->second;
+    load(reg, value);
+    return reg;
+}
+
+void InstructionSelector::store(IRInstruction* value, const std::string& reg) {
+    copy(location(value), reg);
+}
+
+// Moves between registers and slots, through rax from slot to slot.
+void InstructionSelector::copy(const std::string& to, const std::string& from) {
+    if(to == from) return;
+    if(to.starts_with("qword") && from.starts_with("qword")) {
+        textSegment.push_back(new Move("rax", from));
+        textSegment.push_back(new Move(to, "rax"));
+        return;
+    }
+    textSegment.push_back(new Move(to, from));
+}
+
+void InstructionSelector::restoreSaved() {
+    for(const auto& [reg, index] : saved) {
+        textSegment.push_back(new Move(reg, slot(index)));
+    }
+}
+
+void InstructionSelector::selectBlock(IRBlock* block, IRBlock* next) {
+    textSegment.push_back(new Label(localLabel(block)));
+
+    for(IRInstruction* inst : block->instructions) {
+        if(inst->op != IROp::PHI) continue;
+        copy(location(inst), phiLocation(inst));
+    }
+
+    for(IRInstruction* inst : block->instructions) {
+        if(inst->op == IROp::PHI) continue;
+        if(isTerminator(inst->op)) {
+            selectBranch(inst, next);
+            continue;
+        }
+        selectInstruction(inst);
+    }
+}
+
+void InstructionSelector::emitPhiCopies(IRBlock* from, IRBlock* to) {
+    for(IRInstruction* phi : to->instructions) {
+        if(phi->op != IROp::PHI) continue;
+        for(size_t i = 0; i < phi->operands.size(); i++) {
+            if(phi->incoming.at(i) != from) continue;
+            const std::string to = phiLocation(phi);
+            if(to.starts_with("qword")) {
+                load("rax", phi->operands.at(i));
+                textSegment.push_back(new Move(to, "rax"));
+            } else {
+                load(to, phi->operands.at(i));
+            }
+        }
+    }
+}
+
+void InstructionSelector::selectInstruction(IRInstruction* inst) {
+    switch(inst->op) {
+        case IROp::CONST:
+        case IROp::GLOBAL_ADDR:
+        case IROp::STRING_ADDR:
+            // materialized at their uses
+            break;
+        case IROp::PARAM:
+            if(inst->value >= static_cast<long long>(std::size(ARG_REGS))) {
+                throw std::runtime_error(function->name + ": more than 6 parameters are not supported");
+            }
+            store(inst, ARG_REGS[inst->value]);
+            break;
+        case IROp::ADD:
+        case IROp::SUB:
+        case IROp::AND:
+        case IROp::OR: {
+            // the result never shares a register with an operand
+            const std::string result = target(inst);
+            const std::string right = operand(inst->operands.at(1), "rcx");
+            load(result, inst->operands.at(0));
+            if(inst->op == IROp::ADD) textSegment.push_back(new Add(result, right));
+            else if(inst->op == IROp::SUB) textSegment.push_back(new Sub(result, right));
+            else if(inst->op == IROp::AND) textSegment.push_back(new AND(result, right));
+            else textSegment.push_back(new OR(result, right));
+            store(inst, result);
+            break;
+        }
+        case IROp::MUL: {
+            const std::string result = target(inst);
+            const std::string right = inRegister(inst->operands.at(1), "rcx");
+            load(result, inst->operands.at(0));
+            // the low 64 bits of the product do not depend on signedness
+            textSegment.push_back(new Multiply(result, right, true));
+            store(inst, result);
+            break;
+        }
+        case IROp::DIV:
+        case IROp::MOD:
+            load("rax", inst->operands.at(0));
+            load("rcx", inst->operands.at(1));
+            if(inst->sign) textSegment.push_back(new Cqo());
+            else textSegment.push_back(new XOR("edx", "edx"));
+            textSegment.push_back(new Div("rcx", inst->sign));
+            store(inst, inst->op == IROp::DIV ? "rax" : "rdx");
+            break;
+        case IROp::EQ:
+        case IROp::NE:
+        case IROp::LT:
+        case IROp::GT:
+        case IROp::LE:
+        case IROp::GE:
+            if(fused.contains(inst)) break;
+            textSegment.push_back(new Compare(inRegister(inst->operands.at(0), "rax"), operand(inst->operands.at(1), "rcx")));
+            textSegment.push_back(new SetCC(conditionCode(inst->op, inst->sign), "al"));
+            textSegment.push_back(new MoveExtend("movzx", "eax", "al"));
+            store(inst, "rax");
+            break;
+        case IROp::EXTEND:
+            load("rax", inst->operands.at(0));
+            if(inst->width == 4 && !inst->sign) textSegment.push_back(new Move("eax", "eax"));
+            else if(inst->width == 4) textSegment.push_back(new MoveExtend("movsxd", "rax", "eax"));
+            else textSegment.push_back(new MoveExtend(inst->sign ? "movsx" : "movzx", "rax", sizedReg("rax", inst->width)));
+            store(inst, "rax");
+            break;
+        case IROp::LOAD: {
+            std::string addr;
+            if(inst->operands.front()->op == IROp::GLOBAL_ADDR) {
+                addr = "[" + inst->operands.front()->symbol + "]";
+            }
+            else {
+                addr = "[" + inRegister(inst->operands.front(), "rax") + "]";
+            }
+            const std::string mem = sizePrefix(inst->width) + " " + addr;
+            if(inst->width == 8) {
+                textSegment.push_back(new Move(target(inst), mem));
+                store(inst, target(inst));
+                break;
+            }
+            if(inst->width == 4 && !inst->sign) textSegment.push_back(new Move("eax", mem));
+            else if(inst->width == 4) textSegment.push_back(new MoveExtend("movsxd", "rax", mem));
+            else textSegment.push_back(new MoveExtend(inst->sign ? "movsx" : "movzx", "rax", mem));
+            store(inst, "rax");
+            break;
+        }
+        case IROp::STORE: {
+            std::string value;
+            if(inst->width == 8) value = inRegister(inst->operands.at(1), "rcx");
+            else {
+                load("rcx", inst->operands.at(1));
+                value = sizedReg("rcx", inst->width);
+            }
+            std::string addr;
+            if(inst->operands.front()->op == IROp::GLOBAL_ADDR) {
+                addr = "[" + inst->operands.front()->symbol + "]";
+            }
+            else {
+                addr = "[" + inRegister(inst->operands.front(), "rax") + "]";
+            }
+            textSegment.push_back(new Move(addr, value));
+            break;
+        }
+        case IROp::CALL:
+            if(inst->operands.size() > std::size(ARG_REGS)) {
+                throw std::runtime_error(function->name + ": calls with more than 6 arguments are not supported");
+            }
+            for(size_t i = 0; i < inst->operands.size(); i++) {
+                load(ARG_REGS[i], inst->operands.at(i));
+            }
+            if(IntrinsicEmitter::isIntrinsic(inst->symbol)) {
+                std::optional<long long> size;
+                if(inst->operands.size() == 3 && inst->operands.at(2)->op == IROp::CONST) size = inst->operands.at(2)->value;
+                IntrinsicEmitter intrinsic(textSegment, function->name, inlineIndex++, vectorBytes);
+                intrinsic.emit(inst->symbol, size);
+            } else {
+                textSegment.push_back(new Call(inst->symbol));
+            }
+            store(inst, "rax");
+            break;
+        case IROp::SYSCALL:
+            for(size_t i = 0; i < inst->operands.size() && i < std::size(SYSCALL_REGS); i++) {
+                load(SYSCALL_REGS[i], inst->operands.at(i));
+            }
+            textSegment.push_back(new Syscall());
+            store(inst, "rax");
+            break;
+        default:
+            throw std::runtime_error("unexpected instruction in instruction selection: " + inst->toString());
+    }
+}
+
+void InstructionSelector::selectBranch(IRInstruction* inst, IRBlock* next) {
+    IRBlock* block = inst->block;
+
+    if(inst->op == IROp::RET) {
+        if(!inst->operands.empty()) load("rax", inst->operands.front());
+        restoreSaved();
+        if(!frameless) textSegment.push_back(new Leave());
+        textSegment.push_back(new ReturnOp());
+        return;
+    }
+
+    if(inst->op == IROp::SWITCH) {
+        std::vector<IRBlock*> copied;
+        for(IRBlock* target : inst->targets) {
+            if(std::find(copied.begin(), copied.end(), target) != copied.end()) continue;
+            emitPhiCopies(block, target);
+            copied.push_back(target);
+        }
+        std::vector<SwitchEmitter::Case> cases;
+        for(size_t i = 0; i < inst->cases.size(); i++) {
+            cases.push_back({inst->cases.at(i), label(inst->targets.at(i + 1))});
+        }
+        load("rax", inst->operands.front());
+        SwitchEmitter(textSegment, roSegment, function->name, switchIndex++).emit("rax", "rcx", cases, label(inst->targets.front()), inst->sign);
+        return;
+    }
+
+    if(inst->op == IROp::BR) {
+        IRBlock* target = inst->targets.front();
+        emitPhiCopies(block, target);
+        if(target != next) textSegment.push_back(new Jump("jmp", label(target)));
+        return;
+    }
+
+    IRBlock* ifTrue = inst->targets.at(0);
+    IRBlock* ifFalse = inst->targets.at(1);
+    emitPhiCopies(block, ifTrue);
+    if(ifFalse != ifTrue) emitPhiCopies(block, ifFalse);
+
+    IRInstruction* cond = inst->operands.front();
+    std::string cc;
+    if(fused.contains(cond)) {
+        textSegment.push_back(new Compare(inRegister(cond->operands.at(0), "rax"), operand(cond->operands.at(1), "rcx")));
+        cc = conditionCode(cond->op, cond->sign);
+    }
+    else {
+        textSegment.push_back(new Compare(inRegister(cond, "rax"), "0"));
+        cc = "ne";
+    }
+
+    if(ifTrue == next) {
+        textSegment.push_back(new Jump("j" + invertCondition(cc), label(ifFalse)));
+        return;
+    }
+    textSegment.push_back(new Jump("j" + cc, label(ifTrue)));
+    if(ifFalse != next) textSegment.push_back(new Jump("jmp", label(ifFalse)));
+}
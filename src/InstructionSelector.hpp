@@ -0,0 +1,66 @@
+#ifndef INSTRUCTION_SELECTOR_HPP
+#define INSTRUCTION_SELECTOR_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "IR.hpp"
+#include "OpCode.hpp"
+#include "StringPool.hpp"
+
+// Turns an IRFunction into OpCodes. SSA values live in the registers
+// LinearScan hands out and the rest in rbp-relative stack slots; rax, rcx
+// and rdx are used as temporaries. Callee-saved registers that are used are
+// saved in slots of their own. With omitFramePointer, leaves whose slots fit
+// into the red zone address them through rsp and get no frame.
+class InstructionSelector {
+public:
+    InstructionSelector(std::vector<OpCode*>& textSegment, std::vector<OpCode*>& roSegment, StringPool& strings, int vectorBytes = 16, bool omitFramePointer = false);
+
+    void select(IRFunction* function);
+
+private:
+    void assignLocations(const std::vector<IRBlock*>& order);
+    [[nodiscard]] bool entersKernelOrCalls() const;
+    [[nodiscard]] bool isLeaf() const;
+    void selectBlock(IRBlock* block, IRBlock* next);
+    void selectInstruction(IRInstruction* inst);
+    void selectBranch(IRInstruction* inst, IRBlock* next);
+    void emitPhiCopies(IRBlock* from, IRBlock* to);
+
+    std::string operand(IRInstruction* value, const std::string& reg);
+    std::string inRegister(IRInstruction* value, const std::string& reg);
+    void load(const std::string& reg, IRInstruction* value);
+    void store(IRInstruction* value, const std::string& reg);
+    void copy(const std::string& to, const std::string& from);
+    void restoreSaved();
+    [[nodiscard]] std::string location(IRInstruction* value) const;
+    [[nodiscard]] std::string phiLocation(IRInstruction* phi) const;
+    [[nodiscard]] std::string target(IRInstruction* value) const;
+    [[nodiscard]] std::string slot(int index) const;
+    [[nodiscard]] std::string label(const IRBlock* block) const;
+    [[nodiscard]] std::string localLabel(const IRBlock* block) const;
+
+    std::vector<OpCode*>& textSegment;
+    std::vector<OpCode*>& roSegment;
+    StringPool& strings;
+
+    IRFunction* function = nullptr;
+    std::map<IRInstruction*, int> slots;
+    std::map<IRInstruction*, int> phiSlots;
+    std::map<IRInstruction*, std::string> registers;
+    std::map<IRInstruction*, std::string> phiRegisters;
+    std::vector<std::pair<std::string, int>> saved;
+    std::set<IRInstruction*> fused;
+    int frameSize = 0;
+    bool omitFramePointer;
+    bool frameless = false;
+    int vectorBytes;
+    int inlineIndex = 0;
+    int switchIndex = 0;
+};
+
+#endif
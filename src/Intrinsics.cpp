@@ -0,0 +1,478 @@
+#include "Intrinsics.hpp"
+#include "Vectorizer.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Reads that may run past the end of a string stay inside the page of its
+// last byte: aligned vectors never cross a page, unaligned ones are only used
+// when they don't start in the last vector of a page.
+const int PAGE_SIZE = 4096;
+
+// Constant sizes up to UNROLL_LIMIT bytes are expanded into straight-line
+// moves, sizes up to REP_LIMIT use the string instructions and everything
+// else runs a vector loop.
+const long long UNROLL_LIMIT = 64;
+const long long REP_LIMIT = 4096;
+
+struct IntrinsicInfo {
+    std::string name;
+    size_t arguments;
+    TypeIdentifier returnType;
+};
+
+const IntrinsicInfo INTRINSICS[] = {
+    {"__builtin_memcpy", 3, {TypeIdentifierType::U8, 1}},
+    {"__builtin_memset", 3, {TypeIdentifierType::U8, 1}},
+    {"__builtin_memcmp", 3, {TypeIdentifierType::I64, 0}},
+    {"__builtin_memchr", 3, {TypeIdentifierType::U8, 1}},
+    {"__builtin_strlen", 1, {TypeIdentifierType::U64, 0}},
+    {"__builtin_strcmp", 2, {TypeIdentifierType::I64, 0}},
+    {"__builtin_strchr", 2, {TypeIdentifierType::U8, 1}},
+    {"__builtin_atomic_load", 1, {TypeIdentifierType::U64, 0}},
+    {"__builtin_atomic_store", 2, {TypeIdentifierType::VOID, 0}},
+    {"__builtin_atomic_exchange", 2, {TypeIdentifierType::U64, 0}},
+    {"__builtin_atomic_fetch_add", 2, {TypeIdentifierType::U64, 0}},
+    {"__builtin_atomic_cas", 3, {TypeIdentifierType::U64, 0}},
+    {"__builtin_fence", 0, {TypeIdentifierType::VOID, 0}},
+    {"__builtin_pause", 0, {TypeIdentifierType::VOID, 0}},
+    {"__builtin_clone", 3, {TypeIdentifierType::I64, 0}},
+    {"__builtin_call", 4, {TypeIdentifierType::U64, 0}},
+};
+
+static const IntrinsicInfo* findIntrinsic(const std::string& name) {
+    for(const IntrinsicInfo& info : INTRINSICS) {
+        if(info.name == name) return &info;
+    }
+    return nullptr;
+}
+
+static std::string sized(const std::string& reg, const int bytes) {
+    if(bytes == 8) return reg;
+    if(reg == "rax") return bytes == 4 ? "eax" : bytes == 2 ? "ax" : "al";
+    return bytes == 4 ? "ecx" : bytes == 2 ? "cx" : "cl";
+}
+
+static std::string sizeName(const int bytes) {
+    switch(bytes) {
+        case 1: return "byte";
+        case 2: return "word";
+        case 4: return "dword";
+        default: return "qword";
+    }
+}
+
+IntrinsicEmitter::IntrinsicEmitter(std::vector<OpCode*>& textSegment, const std::string& function, const int index, const int vectorBytes) : textSegment(textSegment) {
+    this->function = function;
+    this->index = index;
+    this->vectorBytes = vectorBytes;
+}
+
+bool IntrinsicEmitter::isIntrinsic(const std::string& name) {
+    return findIntrinsic(name) != nullptr;
+}
+
+size_t IntrinsicEmitter::argumentCount(const std::string& name) {
+    return findIntrinsic(name)->arguments;
+}
+
+TypeIdentifier IntrinsicEmitter::returnType(const std::string& name) {
+    return findIntrinsic(name)->returnType;
+}
+
+bool IntrinsicEmitter::makesCall(const std::string& name) {
+    return name == "__builtin_call";
+}
+
+void IntrinsicEmitter::emit(const std::string& name, const std::optional<long long> size) {
+    if(name == "__builtin_memcpy") emitMemcpy(size);
+    else if(name == "__builtin_memset") emitMemset(size);
+    else if(name == "__builtin_memcmp") emitMemcmp();
+    else if(name == "__builtin_memchr") emitMemchr();
+    else if(name == "__builtin_strlen") emitStrlen();
+    else if(name == "__builtin_strcmp") emitStrcmp();
+    else if(name == "__builtin_strchr") emitStrchr();
+    else if(name == "__builtin_clone") emitClone();
+    else if(name == "__builtin_call") emitIndirectCall();
+    else if(name.starts_with("__builtin_atomic_") || name == "__builtin_fence" || name == "__builtin_pause") emitAtomic(name);
+    else throw std::runtime_error("unknown intrinsic: \"" + name + "\"");
+}
+
+void IntrinsicEmitter::emitMemcpy(const std::optional<long long> size) {
+    const bool avx = vectorBytes == 32;
+
+    if(size.has_value() && *size <= UNROLL_LIMIT) {
+        long long offset = 0;
+        for(int chunk : {32, 16, 8, 4, 2, 1}) {
+            if(chunk == 32 && !avx) continue;
+            while(*size - offset >= chunk) {
+                const std::string src = "[rsi + " + std::to_string(offset) + "]";
+                const std::string dst = "[rdi + " + std::to_string(offset) + "]";
+                if(chunk >= 16) {
+                    const std::string reg = chunk == 32 ? "ymm0" : "xmm0";
+                    textSegment.push_back(new SimdOp(avx ? "vmovdqu" : "movdqu", reg, src));
+                    textSegment.push_back(new SimdOp(avx ? "vmovdqu" : "movdqu", dst, reg));
+                } else {
+                    textSegment.push_back(new Move(sized("rcx", chunk), sizeName(chunk) + " " + src));
+                    textSegment.push_back(new Move(sizeName(chunk) + " " + dst, sized("rcx", chunk)));
+                }
+                offset += chunk;
+            }
+        }
+        if(avx && *size >= 32) textSegment.push_back(new SimdOp("vzeroupper", ""));
+        textSegment.push_back(new Move("rax", "rdi"));
+        return;
+    }
+
+    if(size.has_value() && *size <= REP_LIMIT) {
+        textSegment.push_back(new Move("rax", "rdi"));
+        textSegment.push_back(new Move("rcx", "rdx"));
+        textSegment.push_back(new Rep("movsb"));
+        return;
+    }
+
+    VectorLoop loop;
+    loop.kind = VectorLoop::Kind::COPY;
+    textSegment.push_back(new Move("r8", "rdi"));
+    textSegment.push_back(new Move("rcx", "rdx"));
+    textSegment.push_back(new XOR("edx", "edx"));
+    LoopVectorizer(textSegment, function, index, vectorBytes).emit(loop);
+    textSegment.push_back(new Move("rax", "r8"));
+}
+
+void IntrinsicEmitter::emitMemset(const std::optional<long long> size) {
+    const bool avx = vectorBytes == 32;
+
+    if(size.has_value() && *size <= UNROLL_LIMIT) {
+        emitSplat(*size >= 16);
+        long long offset = 0;
+        for(int chunk : {32, 16, 8, 4, 2, 1}) {
+            if(chunk == 32 && !avx) continue;
+            while(*size - offset >= chunk) {
+                const std::string dst = "[rdi + " + std::to_string(offset) + "]";
+                if(chunk == 32) textSegment.push_back(new SimdOp("vmovdqu", dst, "ymm0"));
+                else if(chunk == 16) textSegment.push_back(new SimdOp(avx ? "vmovdqu" : "movdqu", dst, "xmm0"));
+                else textSegment.push_back(new Move(sizeName(chunk) + " " + dst, sized("rax", chunk)));
+                offset += chunk;
+            }
+        }
+        if(avx && *size >= 32) textSegment.push_back(new SimdOp("vzeroupper", ""));
+        textSegment.push_back(new Move("rax", "rdi"));
+        return;
+    }
+
+    if(size.has_value() && *size <= REP_LIMIT) {
+        textSegment.push_back(new Move("r8", "rdi"));
+        textSegment.push_back(new MoveExtend("movzx", "eax", "sil"));
+        textSegment.push_back(new Move("rcx", "rdx"));
+        textSegment.push_back(new Rep("stosb"));
+        textSegment.push_back(new Move("rax", "r8"));
+        return;
+    }
+
+    VectorLoop loop;
+    loop.kind = VectorLoop::Kind::FILL;
+    textSegment.push_back(new Move("r8", "rdi"));
+    textSegment.push_back(new Move("r9", "rsi"));
+    textSegment.push_back(new Move("rcx", "rdx"));
+    textSegment.push_back(new XOR("edx", "edx"));
+    LoopVectorizer(textSegment, function, index, vectorBytes).emit(loop);
+    textSegment.push_back(new Move("rax", "r8"));
+}
+
+// Compares a vector at a time and locates the first differing byte in the
+// pcmpeqb mask; the remaining bytes are compared one by one.
+void IntrinsicEmitter::emitMemcmp() {
+    const bool avx = vectorBytes == 32;
+    const std::string bytes = std::to_string(vectorBytes);
+    const std::string reg0 = avx ? "ymm0" : "xmm0";
+    const std::string reg1 = avx ? "ymm1" : "xmm1";
+
+    textSegment.push_back(new XOR("eax", "eax"));
+    textSegment.push_back(new Label(label("loop")));
+    textSegment.push_back(new Compare("rdx", bytes));
+    textSegment.push_back(new Jump("jb", target("tail")));
+    textSegment.push_back(new SimdOp(avx ? "vmovdqu" : "movdqu", reg0, "[rdi]"));
+    textSegment.push_back(new SimdOp(avx ? "vmovdqu" : "movdqu", reg1, "[rsi]"));
+    if(avx) textSegment.push_back(new SimdOp("vpcmpeqb", reg0, reg0, reg1));
+    else textSegment.push_back(new SimdOp("pcmpeqb", reg0, reg1));
+    textSegment.push_back(new SimdOp(avx ? "vpmovmskb" : "pmovmskb", "ecx", reg0));
+    textSegment.push_back(new Compare("ecx", avx ? "-1" : "0xffff"));
+    textSegment.push_back(new Jump("jne", target("diff")));
+    textSegment.push_back(new Add("rdi", bytes));
+    textSegment.push_back(new Add("rsi", bytes));
+    textSegment.push_back(new Sub("rdx", bytes));
+    textSegment.push_back(new Jump("jmp", target("loop")));
+
+    textSegment.push_back(new Label(label("diff")));
+    textSegment.push_back(new XOR("ecx", "-1"));
+    textSegment.push_back(new BitScan("bsf", "ecx", "ecx"));
+    textSegment.push_back(new MoveExtend("movzx", "eax", "byte [rdi + rcx]"));
+    textSegment.push_back(new MoveExtend("movzx", "ecx", "byte [rsi + rcx]"));
+    textSegment.push_back(new Sub("rax", "rcx"));
+    textSegment.push_back(new Jump("jmp", target("done")));
+
+    textSegment.push_back(new Label(label("tail")));
+    textSegment.push_back(new Test("rdx", "rdx"));
+    textSegment.push_back(new Jump("jz", target("done")));
+    textSegment.push_back(new Label(label("byte")));
+    textSegment.push_back(new MoveExtend("movzx", "eax", "byte [rdi]"));
+    textSegment.push_back(new MoveExtend("movzx", "ecx", "byte [rsi]"));
+    textSegment.push_back(new Sub("rax", "rcx"));
+    textSegment.push_back(new Jump("jnz", target("done")));
+    textSegment.push_back(new Add("rdi", "1"));
+    textSegment.push_back(new Add("rsi", "1"));
+    textSegment.push_back(new Sub("rdx", "1"));
+    textSegment.push_back(new Jump("jnz", target("byte")));
+    textSegment.push_back(new Label(label("done")));
+    if(avx) textSegment.push_back(new SimdOp("vzeroupper", ""));
+}
+
+// strlen is a sentinel scan for 0 starting at index 0.
+void IntrinsicEmitter::emitStrlen() {
+    VectorLoop loop;
+    loop.kind = VectorLoop::Kind::SCAN;
+    textSegment.push_back(new XOR("edx", "edx"));
+    textSegment.push_back(new XOR("r9d", "r9d"));
+    LoopVectorizer(textSegment, function, index, vectorBytes).emit(loop);
+    textSegment.push_back(new Move("rax", "rdx"));
+}
+
+// Returns the address of the first byte equal to sil in the rdx bytes at
+// rdi, or 0. Whole vectors are compared while they fit, the rest one by one.
+void IntrinsicEmitter::emitMemchr() {
+    const std::string bytes = std::to_string(vectorBytes);
+    emitSplat(true);
+
+    textSegment.push_back(new Label(label("loop")));
+    textSegment.push_back(new Compare("rdx", bytes));
+    textSegment.push_back(new Jump("jb", target("tail")));
+    simd("movdqu", vreg(1), "[rdi]");
+    arith("pcmpeqb", vreg(1), vreg(0));
+    simd("pmovmskb", "ecx", vreg(1));
+    textSegment.push_back(new Test("ecx", "ecx"));
+    textSegment.push_back(new Jump("jnz", target("hit")));
+    textSegment.push_back(new Add("rdi", bytes));
+    textSegment.push_back(new Sub("rdx", bytes));
+    textSegment.push_back(new Jump("jmp", target("loop")));
+
+    textSegment.push_back(new Label(label("hit")));
+    textSegment.push_back(new BitScan("bsf", "ecx", "ecx"));
+    textSegment.push_back(new LoadEffectiveAddr("rax", "[rdi + rcx]"));
+    textSegment.push_back(new Jump("jmp", target("done")));
+
+    textSegment.push_back(new Label(label("tail")));
+    textSegment.push_back(new XOR("eax", "eax"));
+    textSegment.push_back(new Test("rdx", "rdx"));
+    textSegment.push_back(new Jump("jz", target("done")));
+    textSegment.push_back(new Label(label("byte")));
+    textSegment.push_back(new Compare("byte [rdi]", "sil"));
+    textSegment.push_back(new Jump("je", target("found")));
+    textSegment.push_back(new Add("rdi", "1"));
+    textSegment.push_back(new Sub("rdx", "1"));
+    textSegment.push_back(new Jump("jnz", target("byte")));
+    textSegment.push_back(new Jump("jmp", target("done")));
+    textSegment.push_back(new Label(label("found")));
+    textSegment.push_back(new Move("rax", "rdi"));
+    textSegment.push_back(new Label(label("done")));
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("vzeroupper", ""));
+}
+
+// Compares a vector of both strings at a time; a byte that differs or a
+// NUL in the first string ends the loop. Near the end of a page either
+// string moves on a byte at a time instead.
+void IntrinsicEmitter::emitStrcmp() {
+    const std::string bytes = std::to_string(vectorBytes);
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("vpxor", vreg(2), vreg(2), vreg(2)));
+    else textSegment.push_back(new SimdOp("pxor", vreg(2), vreg(2)));
+
+    textSegment.push_back(new Label(label("loop")));
+    // the or of both offsets is at least as large as either of them
+    textSegment.push_back(new Move("eax", "edi"));
+    textSegment.push_back(new OR("eax", "esi"));
+    textSegment.push_back(new AND("eax", std::to_string(PAGE_SIZE - 1)));
+    textSegment.push_back(new Compare("eax", std::to_string(PAGE_SIZE - vectorBytes)));
+    textSegment.push_back(new Jump("ja", target("byte")));
+    simd("movdqu", vreg(0), "[rdi]");
+    simd("movdqu", vreg(1), "[rsi]");
+    arith("pcmpeqb", vreg(1), vreg(0));
+    arith("pcmpeqb", vreg(0), vreg(2));
+    simd("pmovmskb", "ecx", vreg(1));
+    simd("pmovmskb", "eax", vreg(0));
+    textSegment.push_back(new XOR("ecx", vectorBytes == 32 ? "-1" : "0xffff"));
+    textSegment.push_back(new OR("ecx", "eax"));
+    textSegment.push_back(new Jump("jnz", target("diff")));
+    textSegment.push_back(new Add("rdi", bytes));
+    textSegment.push_back(new Add("rsi", bytes));
+    textSegment.push_back(new Jump("jmp", target("loop")));
+
+    textSegment.push_back(new Label(label("diff")));
+    textSegment.push_back(new BitScan("bsf", "ecx", "ecx"));
+    textSegment.push_back(new MoveExtend("movzx", "eax", "byte [rdi + rcx]"));
+    textSegment.push_back(new MoveExtend("movzx", "ecx", "byte [rsi + rcx]"));
+    textSegment.push_back(new Sub("rax", "rcx"));
+    textSegment.push_back(new Jump("jmp", target("done")));
+
+    textSegment.push_back(new Label(label("byte")));
+    textSegment.push_back(new MoveExtend("movzx", "eax", "byte [rdi]"));
+    textSegment.push_back(new MoveExtend("movzx", "ecx", "byte [rsi]"));
+    textSegment.push_back(new Sub("rax", "rcx"));
+    textSegment.push_back(new Jump("jnz", target("done")));
+    textSegment.push_back(new Test("ecx", "ecx"));
+    textSegment.push_back(new Jump("jz", target("done")));
+    textSegment.push_back(new Add("rdi", "1"));
+    textSegment.push_back(new Add("rsi", "1"));
+    textSegment.push_back(new Jump("jmp", target("loop")));
+    textSegment.push_back(new Label(label("done")));
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("vzeroupper", ""));
+}
+
+// Returns the address of the first sil in the string at rdi, or 0 if its
+// NUL comes first; looking for 0 finds the NUL. Like strlen it scans
+// aligned vectors and drops the bits in front of the string from the first.
+void IntrinsicEmitter::emitStrchr() {
+    const std::string bytes = std::to_string(vectorBytes);
+    emitSplat(true);
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("vpxor", vreg(2), vreg(2), vreg(2)));
+    else textSegment.push_back(new SimdOp("pxor", vreg(2), vreg(2)));
+
+    textSegment.push_back(new Move("rax", "rdi"));
+    textSegment.push_back(new Move("rcx", "rdi"));
+    textSegment.push_back(new AND("rcx", std::to_string(vectorBytes - 1)));
+    textSegment.push_back(new AND("rax", std::to_string(-vectorBytes)));
+    emitStrchrMask();
+    textSegment.push_back(new Shift("shr", "edx", "cl"));
+    textSegment.push_back(new Test("edx", "edx"));
+    textSegment.push_back(new Jump("jnz", target("head")));
+
+    textSegment.push_back(new Label(label("loop")));
+    textSegment.push_back(new Add("rax", bytes));
+    emitStrchrMask();
+    textSegment.push_back(new Test("edx", "edx"));
+    textSegment.push_back(new Jump("jz", target("loop")));
+    textSegment.push_back(new BitScan("bsf", "edx", "edx"));
+    textSegment.push_back(new Add("rax", "rdx"));
+    textSegment.push_back(new Jump("jmp", target("check")));
+
+    textSegment.push_back(new Label(label("head")));
+    textSegment.push_back(new BitScan("bsf", "edx", "edx"));
+    textSegment.push_back(new LoadEffectiveAddr("rax", "[rdi + rdx]"));
+    textSegment.push_back(new Label(label("check")));
+    textSegment.push_back(new Compare("byte [rax]", "sil"));
+    textSegment.push_back(new Jump("je", target("done")));
+    textSegment.push_back(new XOR("eax", "eax"));
+    textSegment.push_back(new Label(label("done")));
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("vzeroupper", ""));
+}
+
+// Bits in edx for the bytes of the aligned vector at rax that are NUL or
+// equal to the splatted byte in vector 0.
+void IntrinsicEmitter::emitStrchrMask() {
+    simd("movdqa", vreg(1), "[rax]");
+    if(vectorBytes == 32) {
+        textSegment.push_back(new SimdOp("vpcmpeqb", vreg(3), vreg(1), vreg(2)));
+    } else {
+        textSegment.push_back(new SimdOp("movdqa", vreg(3), vreg(1)));
+        textSegment.push_back(new SimdOp("pcmpeqb", vreg(3), vreg(2)));
+    }
+    arith("pcmpeqb", vreg(1), vreg(0));
+    arith("por", vreg(1), vreg(3));
+    simd("pmovmskb", "edx", vreg(1));
+}
+
+// Atomics on the aligned u64 at rdi, all sequentially consistent. x86 loads
+// already have acquire and plain stores release semantics; stores use xchg,
+// whose implicit lock also orders them before later loads. compare and swap
+// returns the old value, it succeeded if that equals the expected one.
+void IntrinsicEmitter::emitAtomic(const std::string& name) {
+    if(name == "__builtin_atomic_load") {
+        textSegment.push_back(new Move("rax", "qword [rdi]"));
+    } else if(name == "__builtin_atomic_store" || name == "__builtin_atomic_exchange") {
+        textSegment.push_back(new Move("rax", "rsi"));
+        textSegment.push_back(new Atomic("xchg", "qword [rdi]", "rax"));
+    } else if(name == "__builtin_atomic_fetch_add") {
+        textSegment.push_back(new Move("rax", "rsi"));
+        textSegment.push_back(new Atomic("lock xadd", "qword [rdi]", "rax"));
+    } else if(name == "__builtin_atomic_cas") {
+        textSegment.push_back(new Move("rax", "rsi"));
+        textSegment.push_back(new Atomic("lock cmpxchg", "qword [rdi]", "rdx"));
+    } else if(name == "__builtin_fence") {
+        textSegment.push_back(new Atomic("mfence"));
+    } else {
+        textSegment.push_back(new Atomic("pause"));
+    }
+}
+
+// clone(flags, stack, tid) with tid as both the parent and the child tid
+// word. The parent gets the new tid or -errno. The child starts on stack,
+// which holds the function to run, its argument and where to store its
+// result, calls it and ends the thread; nothing of the parent's frame is
+// touched on the way.
+void IntrinsicEmitter::emitClone() {
+    textSegment.push_back(new Move("r10", "rdx"));
+    textSegment.push_back(new XOR("r8d", "r8d"));
+    textSegment.push_back(new Move("eax", "56"));
+    textSegment.push_back(new Syscall());
+    textSegment.push_back(new Test("rax", "rax"));
+    textSegment.push_back(new Jump("jnz", target("parent")));
+
+    textSegment.push_back(new XOR("ebp", "ebp"));
+    textSegment.push_back(new Move("rax", "qword [rsp]"));
+    textSegment.push_back(new Move("rdi", "qword [rsp + 8]"));
+    textSegment.push_back(new Move("rbx", "qword [rsp + 16]"));
+    textSegment.push_back(new Call("rax"));
+    textSegment.push_back(new Move("qword [rbx]", "rax"));
+    textSegment.push_back(new XOR("edi", "edi"));
+    textSegment.push_back(new Move("eax", "60"));
+    textSegment.push_back(new Syscall());
+    textSegment.push_back(new Label(label("parent")));
+}
+
+// call(function, a, b, c) calls the function at the address in rdi with the
+// other three arguments moved down one register.
+void IntrinsicEmitter::emitIndirectCall() {
+    textSegment.push_back(new Move("rax", "rdi"));
+    textSegment.push_back(new Move("rdi", "rsi"));
+    textSegment.push_back(new Move("rsi", "rdx"));
+    textSegment.push_back(new Move("rdx", "rcx"));
+    textSegment.push_back(new Call("rax"));
+}
+
+// Repeats the byte in sil across rax and, if vector is set, across xmm0/ymm0.
+void IntrinsicEmitter::emitSplat(const bool vector) {
+    textSegment.push_back(new MoveExtend("movzx", "eax", "sil"));
+    textSegment.push_back(new Move("rcx", "0x0101010101010101"));
+    textSegment.push_back(new Multiply("rax", "rcx", true));
+    if(!vector) return;
+
+    if(vectorBytes == 32) {
+        textSegment.push_back(new SimdOp("vmovq", "xmm0", "rax"));
+        textSegment.push_back(new SimdOp("vpbroadcastq", "ymm0", "xmm0"));
+    } else {
+        textSegment.push_back(new SimdOp("movq", "xmm0", "rax"));
+        textSegment.push_back(new SimdOp("punpcklqdq", "xmm0", "xmm0"));
+    }
+}
+
+void IntrinsicEmitter::simd(const std::string& mnemonic, const std::string& first, const std::string& second) {
+    textSegment.push_back(new SimdOp(vectorBytes == 32 ? "v" + mnemonic : mnemonic, first, second));
+}
+
+// Destructive SSE arithmetic; AVX gets the non-destructive three operand form.
+void IntrinsicEmitter::arith(const std::string& mnemonic, const std::string& first, const std::string& second) {
+    if(vectorBytes == 32) textSegment.push_back(new SimdOp("v" + mnemonic, first, first, second));
+    else textSegment.push_back(new SimdOp(mnemonic, first, second));
+}
+
+std::string IntrinsicEmitter::vreg(const int index) const {
+    return (vectorBytes == 32 ? "ymm" : "xmm") + std::to_string(index);
+}
+
+std::string IntrinsicEmitter::label(const std::string& name) const {
+    return ".builtin" + std::to_string(index) + "_" + name;
+}
+
+std::string IntrinsicEmitter::target(const std::string& name) const {
+    return function + label(name);
+}
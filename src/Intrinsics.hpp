@@ -0,0 +1,57 @@
+#ifndef INTRINSICS_HPP
+#define INTRINSICS_HPP
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "AST.hpp"
+#include "OpCode.hpp"
+
+// Compiler builtins (__builtin_memcpy, __builtin_memset, __builtin_memcmp,
+// __builtin_memchr, __builtin_strlen, __builtin_strcmp, __builtin_strchr,
+// __builtin_clone, __builtin_call and the atomics) that are expanded inline
+// instead of called. Arguments arrive in rdi, rsi, rdx and rcx like for a call
+// and the result is left in rax. Only caller-saved registers and xmm0-xmm3 are
+// clobbered, except by __builtin_call, which is a call as far as the caller's
+// frame is concerned.
+class IntrinsicEmitter {
+public:
+    IntrinsicEmitter(std::vector<OpCode*>& textSegment, const std::string& function, int index, int vectorBytes);
+
+    static bool isIntrinsic(const std::string& name);
+    static size_t argumentCount(const std::string& name);
+    static TypeIdentifier returnType(const std::string& name);
+    // true for the builtins that call a function, callers of them aren't leaves
+    static bool makesCall(const std::string& name);
+
+    // size is the byte count of memcpy/memset/memcmp if it is known at compile time
+    void emit(const std::string& name, std::optional<long long> size);
+
+private:
+    void emitMemcpy(std::optional<long long> size);
+    void emitMemset(std::optional<long long> size);
+    void emitMemcmp();
+    void emitMemchr();
+    void emitStrlen();
+    void emitStrcmp();
+    void emitStrchr();
+    void emitStrchrMask();
+    void emitAtomic(const std::string& name);
+    void emitClone();
+    void emitIndirectCall();
+    void emitSplat(bool vector);
+    void simd(const std::string& mnemonic, const std::string& first, const std::string& second);
+    void arith(const std::string& mnemonic, const std::string& first, const std::string& second);
+    [[nodiscard]] std::string vreg(int index) const;
+
+    [[nodiscard]] std::string label(const std::string& name) const;
+    [[nodiscard]] std::string target(const std::string& name) const;
+
+    std::vector<OpCode*>& textSegment;
+    std::string function;
+    int index;
+    int vectorBytes;
+};
+
+#endif
@@ -20,7 +20,7 @@ void Lexer::passLine(const std::string& line, const unsigned int number) {
 
         if(isspace(c)) continue;
 
-        if(isalpha(c)) {
+        if(isalpha(c) || c == '_') {
             std::string buf;
             buf.push_back(c);
             i++;
@@ -69,6 +69,9 @@ void Lexer::passLine(const std::string& line, const unsigned int number) {
                     case 't':
                         tokens.push_back(Token{CHAR_LITERAL, number, {}, {}, '\t', i});
                         break;
+                    case 'r':
+                        tokens.push_back(Token{CHAR_LITERAL, number, {}, {}, '\r', i});
+                        break;
                     case '0':
                         tokens.push_back(Token{CHAR_LITERAL, number, {}, {}, '\0', i});
                 }
@@ -165,7 +168,7 @@ void Lexer::passLine(const std::string& line, const unsigned int number) {
                     }
                     break;
                 case '|':
-                    if(line.at(i+1) == '|') {
+                    if(i+1 < line.size() && line.at(i+1) == '|') {
                         tokens.push_back(Token{LOGIC_OR, number, {}, {}, {}, i});
                         i++;
                     } else {
@@ -173,7 +176,7 @@ void Lexer::passLine(const std::string& line, const unsigned int number) {
                     }
                     break;
                 case '&':
-                    if(line.at(i+1 == '&')) {
+                    if(i+1 < line.size() && line.at(i+1) == '&') {
                         tokens.push_back(Token{LOGIC_AND, number, {}, {}, {}, i});
                         i++;
                     } else {
@@ -0,0 +1,190 @@
+#include "LinearScan.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+LinearScan::LinearScan(const std::vector<IRBlock*>& order, const std::vector<IRInstruction*>& values, const std::set<IRInstruction*>& fused)
+    : order(order), fused(fused) {
+    for(IRInstruction* value : values) {
+        numbers[value] = count++;
+    }
+    for(IRInstruction* value : values) {
+        if(value->op == IROp::PHI) copyNumbers[value] = count++;
+    }
+    buildSteps();
+    computeLiveness();
+}
+
+void LinearScan::use(Step& step, IRInstruction* operand) const {
+    if(fused.contains(operand)) {
+        for(IRInstruction* compared : operand->operands) use(step, compared);
+        return;
+    }
+    const auto found = numbers.find(operand);
+    if(found != numbers.end()) step.uses.push_back(found->second);
+}
+
+// One step for the phis at the top of a block, one per instruction and one
+// for the terminator together with the phi copies in front of it.
+void LinearScan::buildSteps() {
+    int position = 0;
+    for(IRBlock* block : order) {
+        std::vector<Step>& list = steps[block];
+        Step top{position++, {}, {}};
+        for(IRInstruction* inst : block->instructions) {
+            if(inst->op != IROp::PHI) continue;
+            top.uses.push_back(copyNumbers.find(inst)->second);
+            top.defs.push_back(numbers.find(inst)->second);
+        }
+        list.push_back(top);
+
+        for(IRInstruction* inst : block->instructions) {
+            if(inst->op == IROp::PHI) continue;
+            Step step{position++, {}, {}};
+            if(isTerminator(inst->op)) {
+                std::vector<IRBlock*> copied;
+                for(IRBlock* target : inst->targets) {
+                    if(std::find(copied.begin(), copied.end(), target) != copied.end()) continue;
+                    copied.push_back(target);
+                    for(IRInstruction* phi : target->instructions) {
+                        if(phi->op != IROp::PHI) continue;
+                        for(size_t i = 0; i < phi->operands.size(); i++) {
+                            if(phi->incoming.at(i) != block) continue;
+                            use(step, phi->operands.at(i));
+                            step.defs.push_back(copyNumbers.find(phi)->second);
+                        }
+                    }
+                }
+                for(IRInstruction* operand : inst->operands) use(step, operand);
+            }
+            // a fused compare is emitted with the branch, which uses its operands
+            else if(!fused.contains(inst)) {
+                for(IRInstruction* operand : inst->operands) use(step, operand);
+                const auto found = numbers.find(inst);
+                if(found != numbers.end()) step.defs.push_back(found->second);
+            }
+            list.push_back(step);
+        }
+    }
+}
+
+void LinearScan::computeLiveness() {
+    std::map<IRBlock*, std::set<int>> gen;
+    std::map<IRBlock*, std::set<int>> kill;
+    for(IRBlock* block : order) {
+        for(const Step& step : steps.find(block)->second) {
+            for(const int value : step.uses) {
+                if(!kill[block].contains(value)) gen[block].insert(value);
+            }
+            for(const int value : step.defs) kill[block].insert(value);
+        }
+        liveIn[block] = gen[block];
+        liveOut[block];
+    }
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(auto it = order.rbegin(); it != order.rend(); ++it) {
+            IRBlock* block = *it;
+            std::set<int> out;
+            for(IRBlock* succ : block->succs) {
+                const std::set<int>& in = liveIn[succ];
+                out.insert(in.begin(), in.end());
+            }
+            std::set<int> in = gen[block];
+            for(const int value : out) {
+                if(!kill[block].contains(value)) in.insert(value);
+            }
+            if(in != liveIn[block] || out != liveOut[block]) {
+                liveIn[block] = std::move(in);
+                liveOut[block] = std::move(out);
+                changed = true;
+            }
+        }
+    }
+}
+
+std::vector<LinearScan::Interval> LinearScan::buildIntervals() const {
+    std::vector<Interval> intervals(count);
+    for(int i = 0; i < count; i++) intervals.at(i) = {i, INT_MAX, -1};
+    auto extend = [&](const int value, const int position) {
+        Interval& interval = intervals.at(value);
+        interval.start = std::min(interval.start, position);
+        interval.end = std::max(interval.end, position);
+    };
+
+    for(IRBlock* block : order) {
+        const std::vector<Step>& list = steps.find(block)->second;
+        for(const int value : liveIn.find(block)->second) extend(value, list.front().position);
+        for(const int value : liveOut.find(block)->second) extend(value, list.back().position);
+        for(const Step& step : list) {
+            for(const int value : step.uses) extend(value, step.position);
+            for(const int value : step.defs) extend(value, step.position);
+        }
+    }
+
+    std::erase_if(intervals, [](const Interval& interval) { return interval.end < 0; });
+    std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+        return a.start != b.start ? a.start < b.start : a.value < b.value;
+    });
+    return intervals;
+}
+
+// A value used at the position another is defined at needs a different
+// register, so intervals only end strictly before the next one starts.
+void LinearScan::assign(const std::vector<std::string>& registers) {
+    this->registers = registers;
+    assigned.clear();
+    std::vector<bool> taken(registers.size(), false);
+    std::vector<Interval> active;   // by end
+
+    for(const Interval& interval : buildIntervals()) {
+        while(!active.empty() && active.front().end < interval.start) {
+            taken.at(assigned.find(active.front().value)->second) = false;
+            active.erase(active.begin());
+        }
+
+        const auto free = std::find(taken.begin(), taken.end(), false);
+        if(free != taken.end()) {
+            *free = true;
+            assigned[interval.value] = static_cast<int>(free - taken.begin());
+        } else {
+            if(active.empty() || active.back().end <= interval.end) continue;
+            const Interval spilled = active.back();
+            active.pop_back();
+            assigned[interval.value] = assigned.find(spilled.value)->second;
+            assigned.erase(spilled.value);
+        }
+        const auto at = std::upper_bound(active.begin(), active.end(), interval, [](const Interval& a, const Interval& b) {
+            return a.end < b.end;
+        });
+        active.insert(at, interval);
+    }
+}
+
+std::string LinearScan::getRegister(IRInstruction* value) const {
+    const auto number = numbers.find(value);
+    if(number == numbers.end()) return "";
+    const auto found = assigned.find(number->second);
+    return found == assigned.end() ? "" : registers.at(found->second);
+}
+
+std::string LinearScan::getCopyRegister(IRInstruction* phi) const {
+    const auto number = copyNumbers.find(phi);
+    if(number == copyNumbers.end()) return "";
+    const auto found = assigned.find(number->second);
+    return found == assigned.end() ? "" : registers.at(found->second);
+}
+
+std::vector<std::string> LinearScan::getUsed() const {
+    std::vector<bool> used(registers.size(), false);
+    for(const auto& [value, reg] : assigned) used.at(reg) = true;
+    std::vector<std::string> result;
+    for(size_t i = 0; i < registers.size(); i++) {
+        if(used.at(i)) result.push_back(registers.at(i));
+    }
+    return result;
+}
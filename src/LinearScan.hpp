@@ -0,0 +1,70 @@
+#ifndef LINEAR_SCAN_HPP
+#define LINEAR_SCAN_HPP
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "IR.hpp"
+
+// Linear scan register assignment (Poletto and Sarkar, "Linear Scan Register
+// Allocation"). Positions follow the blocks in the order they are emitted,
+// and every value gets one interval from the first to the last position it
+// is live at, holes included. When the registers run out, whichever of the
+// new interval and the active ones ends last goes to the stack.
+//
+// Besides its own value a phi has a copy, written by its predecessors right
+// before they branch and read at the top of its block, so the phis of a
+// block are updated as one parallel copy.
+class LinearScan {
+public:
+    // values are the instructions that need a place of their own; other
+    // operands, like constants, are materialized at their uses. The operands
+    // of a fused compare are used at the branch of its block.
+    LinearScan(const std::vector<IRBlock*>& order, const std::vector<IRInstruction*>& values, const std::set<IRInstruction*>& fused);
+
+    void assign(const std::vector<std::string>& registers);
+
+    // "" for values that go to the stack
+    [[nodiscard]] std::string getRegister(IRInstruction* value) const;
+    [[nodiscard]] std::string getCopyRegister(IRInstruction* phi) const;
+    // the registers handed out, in the order they were offered
+    [[nodiscard]] std::vector<std::string> getUsed() const;
+
+private:
+    // what an instruction reads and writes at one position; uses come first
+    struct Step {
+        int position;
+        std::vector<int> uses;
+        std::vector<int> defs;
+    };
+
+    struct Interval {
+        int value;
+        int start;
+        int end;
+    };
+
+    void buildSteps();
+    void computeLiveness();
+    [[nodiscard]] std::vector<Interval> buildIntervals() const;
+    void use(Step& step, IRInstruction* operand) const;
+
+    std::vector<IRBlock*> order;
+    const std::set<IRInstruction*>& fused;
+
+    // values are numbered in the order given, phi copies after them
+    std::map<IRInstruction*, int> numbers;
+    std::map<IRInstruction*, int> copyNumbers;
+    int count = 0;
+
+    std::map<IRBlock*, std::vector<Step>> steps;
+    std::map<IRBlock*, std::set<int>> liveIn;
+    std::map<IRBlock*, std::set<int>> liveOut;
+
+    std::vector<std::string> registers;
+    std::map<int, int> assigned;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef OPCODE_HPP
 #define OPCODE_HPP
 
+#include <array>
 #include <cstdio>
 #include <string>
 
@@ -48,6 +49,43 @@ private:
     std::string name;
 };
 
+// function entries and loop heads start on this boundary so their first
+// fetch isn't split
+const int CODE_ALIGNMENT = 16;
+
+// Pads with nops up to the next multiple of bytes.
+class Align final : public OpCode {
+public:
+    explicit Align(const int bytes) {
+        this->bytes = bytes;
+    }
+
+    std::string genNasm() override {
+        return "\talign " + std::to_string(bytes);
+    }
+
+private:
+    int bytes;
+};
+
+// Switches to the section name, which is created with the given attributes
+// on first use.
+class Section final : public OpCode {
+public:
+    Section(const std::string& name, const std::string& attributes) {
+        this->name = name;
+        this->attributes = attributes;
+    }
+
+    std::string genNasm() override {
+        return "section " + name + " " + attributes;
+    }
+
+private:
+    std::string name;
+    std::string attributes;
+};
+
 class Push final : public OpCode {
 public:
     explicit Push(const std::string& reg) {
@@ -165,7 +203,7 @@ private:
 };
 
 enum class BinaryOperator {
-    PLUS, MINUS, MUL, DIV, MOD, EQUALS, NEQUALS, LESS, GREATER, LEQUALS, GEQUALS, BIT_OR, BIT_AND
+    PLUS, MINUS, MUL, DIV, MOD, EQUALS, NEQUALS, LESS, GREATER, LEQUALS, GEQUALS, BIT_OR, BIT_AND, LOGIC_AND, LOGIC_OR
 };
 
 class Add final : public OpCode {
@@ -282,7 +320,7 @@ public:
 
     std::string genNasm() override
     {
-        std::string out = "\tor ";
+        std::string out = "\tand ";
         out.append(first);
         out.append(", ");
         out.append(second);
@@ -316,17 +354,19 @@ private:
     std::string second;
 };
 
+// Sets all of result to 1 if the comparison with condition code cc holds
+// and to 0 otherwise.
 class Comparison final : public OpCode
 {
 public:
 
-    Comparison(const std::string& first, const std::string& second, const std::string& cmp1, const std::string& cmp2, const std::string& reg, BinaryOperator op) {
+    Comparison(const std::string& first, const std::string& second, const std::string& cmp1, const std::string& cmp2, const std::string& result, const std::string& cc) {
         this->first = first;
         this->second = second;
-        this->op = op;
+        this->cc = cc;
         this->cmp1 = cmp1;
         this->cmp2 = cmp2;
-        this->reg = reg;
+        this->result = result;
     }
 
     std::string genNasm() override
@@ -342,45 +382,15 @@ public:
         out.append(", ");
         out.append(second);
         out.append("\n\tcmov");
-
-        switch (op) {
-        case BinaryOperator::PLUS:
-        case BinaryOperator::MINUS:
-        case BinaryOperator::MUL:
-        case BinaryOperator::DIV:
-        case BinaryOperator::BIT_OR:
-        case BinaryOperator::BIT_AND:
-            break;
-        case BinaryOperator::EQUALS:
-            out.append("e");
-            break;
-        case BinaryOperator::NEQUALS:
-            out.append("ne");
-            break;
-        case BinaryOperator::LESS:
-            out.append("l");
-            break;
-        case BinaryOperator::GREATER:
-            out.append("g");
-            break;
-        case BinaryOperator::LEQUALS:
-            out.append("le");
-            break;
-        case BinaryOperator::GEQUALS:
-            out.append("ge");
-            break;
-        case BinaryOperator::MOD:
-            break;
-        }
-
+        out.append(cc);
         out.append(" ");
         out.append(cmp1);
         out.append(", ");
         out.append(cmp2);
         out.append("\n\tmov ");
-        out.append(first);
+        out.append(result);
         out.append(", ");
-        out.append(reg);
+        out.append(cmp1);
         return out;
     }
 
@@ -389,65 +399,232 @@ private:
     std::string second;
     std::string cmp1;
     std::string cmp2;
+    std::string result;
+    std::string cc;
+};
+
+class SetCC final : public OpCode
+{
+public:
+    SetCC(const std::string& type, const std::string& reg) {
+        this->type = type;
+        this->reg = reg;
+    }
+
+    std::string genNasm() override
+    {
+        std::string out = "\tset";
+        out.append(type);
+        out.append(" ");
+        out.append(reg);
+        return out;
+    }
+
+private:
+    std::string type;
     std::string reg;
-    BinaryOperator op;
 };
 
-class Syscall final : public OpCode {
+class MoveExtend final : public OpCode {
 public:
+    // type is one of "movzx", "movsx" or "movsxd"
+    MoveExtend(const std::string& type, const std::string& first, const std::string& second) {
+        this->type = type;
+        this->first = first;
+        this->second = second;
+    }
+
     std::string genNasm() override {
-        return "\tsyscall";
+        std::string out = "\t";
+        out.append(type);
+        out.append(" ");
+        out.append(first);
+        out.append(", ");
+        out.append(second);
+        return out;
     }
+
+private:
+    std::string type;
+    std::string first;
+    std::string second;
 };
 
-class Call final : public OpCode {
+class Cqo final : public OpCode {
 public:
-    explicit Call(const std::string& func) {
-        this->func = func;
+    std::string genNasm() override {
+        return "\tcqo";
     }
+};
 
+class Leave final : public OpCode {
+public:
     std::string genNasm() override {
-        return "\tcall " + func;
+        return "\tleave";
+    }
+};
+
+class Shift final : public OpCode {
+public:
+    // type is one of "shl", "shr" or "sar"
+    Shift(const std::string& type, const std::string& first, const std::string& second) {
+        this->type = type;
+        this->first = first;
+        this->second = second;
+    }
+
+    std::string genNasm() override {
+        std::string out = "\t";
+        out.append(type);
+        out.append(" ");
+        out.append(first);
+        out.append(", ");
+        out.append(second);
+        return out;
     }
 
 private:
-    std::string func;
+    std::string type;
+    std::string first;
+    std::string second;
 };
 
-class ReturnOp final : public OpCode {
+class Test final : public OpCode {
 public:
+    Test(const std::string& first, const std::string& second) {
+        this->first = first;
+        this->second = second;
+    }
+
     std::string genNasm() override {
-        return "\tret";
+        std::string out = "\ttest ";
+        out.append(first);
+        out.append(", ");
+        out.append(second);
+        return out;
+    }
+
+private:
+    std::string first;
+    std::string second;
+};
+
+class BitScan final : public OpCode {
+public:
+    // type is one of "bsf", "bsr" or "tzcnt"
+    BitScan(const std::string& type, const std::string& first, const std::string& second) {
+        this->type = type;
+        this->first = first;
+        this->second = second;
+    }
+
+    std::string genNasm() override {
+        std::string out = "\t";
+        out.append(type);
+        out.append(" ");
+        out.append(first);
+        out.append(", ");
+        out.append(second);
+        return out;
+    }
+
+private:
+    std::string type;
+    std::string first;
+    std::string second;
+};
+
+class Rep final : public OpCode {
+public:
+    // instruction is a string instruction such as "movsb" or "stosb"
+    explicit Rep(const std::string& instruction) {
+        this->instruction = instruction;
+    }
+
+    std::string genNasm() override {
+        return "\trep " + instruction;
     }
+
+private:
+    std::string instruction;
 };
 
-class DefineString final : public OpCode {
+// Locked read-modify-write, xchg or fence. The mnemonic includes the lock
+// prefix where one is needed.
+class Atomic final : public OpCode {
 public:
-    DefineString(const std::string& toDefine, const int index) {
-        this->toDefine = toDefine;
-        this->index = index;
+    explicit Atomic(const std::string& mnemonic, const std::string& first = "", const std::string& second = "") {
+        this->mnemonic = mnemonic;
+        this->first = first;
+        this->second = second;
+    }
 
-        id = "string_" + std::to_string(index);
+    std::string genNasm() override {
+        std::string out = "\t" + mnemonic;
+        if(!first.empty()) out.append(" " + first);
+        if(!second.empty()) out.append(", " + second);
+        return out;
     }
 
-    std::string getId() {
-        return id;
+private:
+    std::string mnemonic;
+    std::string first;
+    std::string second;
+};
+
+// SSE/AVX instruction. The mnemonic is emitted as is, so the caller picks
+// the legacy or VEX encoded form.
+class SimdOp final : public OpCode {
+public:
+    SimdOp(const std::string& mnemonic, const std::string& first, const std::string& second = "", const std::string& third = "", const std::string& fourth = "") {
+        this->mnemonic = mnemonic;
+        this->operands = {first, second, third, fourth};
     }
 
     std::string genNasm() override {
-        replaceAll(toDefine, "\\n", "\", 0xA, \"");
         std::string out = "\t";
-        out.append(id);
-        out.append(": db \"");
-        out.append(toDefine);
-        out.append("\", 0");
+        out.append(mnemonic);
+        bool firstOperand = true;
+        for(const std::string& operand : operands) {
+            if(operand.empty()) break;
+            out.append(firstOperand ? " " : ", ");
+            out.append(operand);
+            firstOperand = false;
+        }
         return out;
     }
 
 private:
-    std::string toDefine;
-    std::string id;
-    int index;
+    std::string mnemonic;
+    std::array<std::string, 4> operands;
+};
+
+class Syscall final : public OpCode {
+public:
+    std::string genNasm() override {
+        return "\tsyscall";
+    }
+};
+
+class Call final : public OpCode {
+public:
+    explicit Call(const std::string& func) {
+        this->func = func;
+    }
+
+    std::string genNasm() override {
+        return "\tcall " + func;
+    }
+
+private:
+    std::string func;
+};
+
+class ReturnOp final : public OpCode {
+public:
+    std::string genNasm() override {
+        return "\tret";
+    }
 };
 
 class DefineVar final : public OpCode {
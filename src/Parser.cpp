@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <ostream>
+#include <set>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -55,6 +56,7 @@ Program* Parser::parse() {
     // import core
     if(core) {
         std::string corePath("stdlib/core.glang");
+        TimeReport::Region region(timeReport, corePath, "module");
         std::fstream file(corePath);
         std::string line;
         unsigned int number = 1;
@@ -64,6 +66,7 @@ Program* Parser::parse() {
         }
         file.close();
         Parser parser(lexer.getTokens(), corePath, false);
+        parser.setTimeReport(timeReport);
         Program* import_prog = parser.parse();
 
         for (FunctionDefinition* def : import_prog->functions) {
@@ -104,7 +107,12 @@ Program* Parser::parse() {
             expectIdentifier();
 
             const auto typeId = consumeString().value();
-            const auto type = TypeIdentifier{strToTypeId(typeId)};
+            int ptrDepth = 0;
+            while(peek().type == STAR) {
+                consume(STAR);
+                ptrDepth++;
+            }
+            const auto type = TypeIdentifier{strToTypeId(typeId), ptrDepth};
 
             Statement* body = parseStatement(true);
 
@@ -175,6 +183,7 @@ Program* Parser::parse() {
                 importPath.append(".glang");
             }
 
+            TimeReport::Region region(timeReport, importPath, "module");
             std::fstream file(importPath);
             std::string line;
             unsigned int number = 1;
@@ -184,6 +193,7 @@ Program* Parser::parse() {
             }
             file.close();
             Parser parser(lexer.getTokens(), importPath, false);
+            parser.setTimeReport(timeReport);
             Program* import_prog = parser.parse();
 
             for (FunctionDefinition* def : import_prog->functions) {
@@ -231,12 +241,12 @@ Statement* Parser::parseStatement(const bool funcBody) {
 
         consume(RCURLY);
 
+        statements.push_back(new EndCompound());
         auto* compound = new Compound(statements);
         compound->lineNum = line;
         compound->colNum = col;
         compound->path = path;
 
-        statements.push_back(new EndCompound());
         return compound;
     }
     if(peek().type == IDENTIFIER) {
@@ -321,6 +331,9 @@ Statement* Parser::parseStatement(const bool funcBody) {
             ifStmt->path = path;
             return ifStmt;
         }
+        if(id == "switch") {
+            return parseSwitch();
+        }
         if(peek(1).type == LPAREN) {
             consume(IDENTIFIER);
             consume(LPAREN);
@@ -360,7 +373,7 @@ Statement* Parser::parseStatement(const bool funcBody) {
 
 Expression* Parser::parseExpression(const int until)
 {
-    return parseBitOrAnd(until);
+    return parseLogicOr(until);
 }
 
 Expression* Parser::parseCallExpression(const int until) {
@@ -384,7 +397,7 @@ Expression* Parser::parseParen(const int until) {
     if (peek().type != LPAREN) return parseSingle();
 
     consume(LPAREN);
-    Expression* expr = parseAddSub(findEndParen());
+    Expression* expr = parseExpression(findEndParen());
     consume(RPAREN);
 
     return expr;
@@ -482,6 +495,42 @@ Expression* Parser::parseSingle() {
     return expr;
 }
 
+Expression* Parser::parseLogicOr(const int until) {
+    const int next = findLastOutsideParen(LOGIC_OR, until);
+    if(next == -1) return parseLogicAnd(until);
+
+    int line = peek().line;
+    int col = peek().col;
+
+    Expression* left = parseLogicOr(next);
+    consume(LOGIC_OR);
+    Expression* right = parseLogicAnd(until);
+
+    auto* expr = new BinaryExpression(BinaryOperator::LOGIC_OR, left, right);
+    expr->lineNum = line;
+    expr->colNum = col;
+    expr->path = path;
+    return expr;
+}
+
+Expression* Parser::parseLogicAnd(const int until) {
+    const int next = findLastOutsideParen(LOGIC_AND, until);
+    if(next == -1) return parseBitOrAnd(until);
+
+    int line = peek().line;
+    int col = peek().col;
+
+    Expression* left = parseLogicAnd(next);
+    consume(LOGIC_AND);
+    Expression* right = parseBitOrAnd(until);
+
+    auto* expr = new BinaryExpression(BinaryOperator::LOGIC_AND, left, right);
+    expr->lineNum = line;
+    expr->colNum = col;
+    expr->path = path;
+    return expr;
+}
+
 Expression* Parser::parseBitOrAnd(const int until) {
     int nextOr = findLastOutsideParen(BIT_OR, until);
     int NextAnd = findLastOutsideParen(BIT_AND, until);
@@ -592,6 +641,67 @@ Expression* Parser::parseMulDiv(const int until) {
     return expr;
 }
 
+// switch(value) { case 1, 2: stmt case 'a': stmt default: stmt }
+// Cases don't fall through; each value may appear only once.
+Statement* Parser::parseSwitch() {
+    int line = peek().line;
+    int col = peek().col;
+
+    consume(IDENTIFIER);
+    consume(LPAREN);
+    Expression* value = parseExpression(findEndParen());
+    consume(RPAREN);
+    consume(LCURLY);
+
+    auto* sw = new Switch(value);
+    std::set<long long> seen;
+    while(peek().type != RCURLY) {
+        if(peek().type == IDENTIFIER && peek().stringValue.value() == "case") {
+            consume(IDENTIFIER);
+            Switch::Case c;
+            while(true) {
+                const long long v = parseCaseValue();
+                if(!seen.insert(v).second) {
+                    std::cerr << path << ":" << peek().line << ": duplicate case value " << v << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                c.values.push_back(v);
+                if(peek().type != COMMA) break;
+                consume(COMMA);
+            }
+            consume(COLON);
+            c.body = parseStatement();
+            sw->cases.push_back(c);
+        }
+        else if(peek().type == IDENTIFIER && peek().stringValue.value() == "default" && sw->defaultBody == nullptr) {
+            consume(IDENTIFIER);
+            consume(COLON);
+            sw->defaultBody = parseStatement();
+        }
+        else {
+            std::cerr << path << ":" << peek().line << ": expected case or default but found: " << peek().toString() << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    consume(RCURLY);
+
+    sw->lineNum = line;
+    sw->colNum = col;
+    sw->path = path;
+    return sw;
+}
+
+long long Parser::parseCaseValue() {
+    if(peek().type == CHAR_LITERAL) return consumeChar().value();
+    if(peek().type == INT_LIT) return consumeInt().value();
+    if(peek().type == MINUS) {
+        consume(MINUS);
+        return -static_cast<long long>(consumeInt().value());
+    }
+    std::cerr << path << ":" << peek().line << ": expected INT_LIT or CHAR_LITERAL as case value but found: " << peek().toString() << std::endl;
+    exit(EXIT_FAILURE);
+}
+
 std::vector<Expression*> Parser::parseArgs(const int until)
 {
     std::vector<Expression*> exprs;
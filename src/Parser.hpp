@@ -2,6 +2,7 @@
 #define PARSER_HPP
 
 #include "AST.hpp"
+#include "TimeReport.hpp"
 #include "Token.hpp"
 
 #include <vector>
@@ -13,20 +14,27 @@ public:
     ~Parser() = default;
 
     Program* parse();
+    // imported modules are timed as regions of their own
+    void setTimeReport(TimeReport* report) { timeReport = report; }
 
 private:
     std::vector<Token> tokens;
     std::string path;
     int counter = 0;
     bool core;
+    TimeReport* timeReport = nullptr;
 
     Statement* parseStatement(bool funcBody = false);
+    Statement* parseSwitch();
+    long long parseCaseValue();
     std::vector<Expression*> parseArgs(int until);
     std::vector<FunctionDefinition::ParamData> parseParameters();
 
     Expression* parseExpression(int until);
     Expression* parseCallExpression(int until);
     Expression* parseParen(int until);
+    Expression* parseLogicOr(int until);
+    Expression* parseLogicAnd(int until);
     Expression* parseBitOrAnd(int until);
     Expression* parseAddSub(int until);
     Expression* parseMulDiv(int until);
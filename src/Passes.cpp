@@ -0,0 +1,465 @@
+#include "Passes.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+PassManager::~PassManager() {
+    for(const Pass* pass : passes) {
+        delete pass;
+    }
+}
+
+void PassManager::addPass(Pass* pass) {
+    passes.push_back(pass);
+}
+
+void PassManager::addStandardPasses() {
+    addPass(new SparseConditionalConstantPropagation());
+    addPass(new GlobalValueNumbering());
+    addPass(new DeadCodeElimination());
+}
+
+bool PassManager::run(IRFunction* function) const {
+    if(printAfterEach) {
+        std::cout << "; IR for " << function->name << std::endl << function->toString() << std::endl;
+    }
+
+    bool changed = false;
+    for(Pass* pass : passes) {
+        changed |= pass->run(function);
+        if(printAfterEach) {
+            std::cout << "; after " << pass->getName() << std::endl << function->toString() << std::endl;
+        }
+    }
+    return changed;
+}
+
+bool foldConstant(const IROp op, const bool sign, const int width, const long long left, const long long right, long long& result) {
+    // do the arithmetic unsigned so overflow wraps instead of being UB
+    const auto l = static_cast<unsigned long long>(left);
+    const auto r = static_cast<unsigned long long>(right);
+
+    switch(op) {
+        case IROp::ADD: result = static_cast<long long>(l + r); return true;
+        case IROp::SUB: result = static_cast<long long>(l - r); return true;
+        case IROp::MUL: result = static_cast<long long>(l * r); return true;
+        case IROp::AND: result = static_cast<long long>(l & r); return true;
+        case IROp::OR:  result = static_cast<long long>(l | r); return true;
+        case IROp::DIV:
+        case IROp::MOD:
+            if(right == 0) return false;
+            if(sign) {
+                if(left == LLONG_MIN && right == -1) return false;
+                result = op == IROp::DIV ? left / right : left % right;
+            }
+            else {
+                result = static_cast<long long>(op == IROp::DIV ? l / r : l % r);
+            }
+            return true;
+        case IROp::EQ: result = left == right; return true;
+        case IROp::NE: result = left != right; return true;
+        case IROp::LT: result = sign ? left < right : l < r; return true;
+        case IROp::GT: result = sign ? left > right : l > r; return true;
+        case IROp::LE: result = sign ? left <= right : l <= r; return true;
+        case IROp::GE: result = sign ? left >= right : l >= r; return true;
+        case IROp::EXTEND:
+            switch(width) {
+                case 1: result = sign ? static_cast<int8_t>(left) : static_cast<uint8_t>(left); return true;
+                case 2: result = sign ? static_cast<int16_t>(left) : static_cast<uint16_t>(left); return true;
+                case 4: result = sign ? static_cast<int32_t>(left) : static_cast<long long>(static_cast<uint32_t>(left)); return true;
+                default: result = left; return true;
+            }
+        default:
+            return false;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///                          DeadCodeElimination                             ///
+////////////////////////////////////////////////////////////////////////////////
+
+bool DeadCodeElimination::run(IRFunction* function) {
+    bool changed = function->removeUnreachableBlocks();
+
+    std::set<IRInstruction*> live;
+    std::vector<IRInstruction*> worklist;
+    for(const IRBlock* block : function->blocks) {
+        for(IRInstruction* inst : block->instructions) {
+            if(hasSideEffects(inst->op)) worklist.push_back(inst);
+        }
+    }
+    // parameters stay so the instruction selector can still find them
+    for(IRInstruction* param : function->params) {
+        worklist.push_back(param);
+    }
+
+    while(!worklist.empty()) {
+        IRInstruction* inst = worklist.back();
+        worklist.pop_back();
+        if(!live.insert(inst).second) continue;
+        for(IRInstruction* operand : inst->operands) {
+            worklist.push_back(operand);
+        }
+    }
+
+    for(IRBlock* block : function->blocks) {
+        const size_t before = block->instructions.size();
+        block->instructions.erase(std::remove_if(block->instructions.begin(), block->instructions.end(), [&](IRInstruction* inst) {
+            return !live.contains(inst);
+        }), block->instructions.end());
+        changed |= before != block->instructions.size();
+    }
+
+    return changed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///                         GlobalValueNumbering                             ///
+////////////////////////////////////////////////////////////////////////////////
+
+// Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+static std::map<IRBlock*, IRBlock*> computeDominators(const IRFunction* function) {
+    const std::vector<IRBlock*> order = function->reversePostOrder();
+    std::map<IRBlock*, int> index;
+    for(size_t i = 0; i < order.size(); i++) {
+        index[order.at(i)] = static_cast<int>(i);
+    }
+
+    std::map<IRBlock*, IRBlock*> idom;
+    IRBlock* entry = order.front();
+    idom[entry] = entry;
+
+    auto intersect = [&](IRBlock* a, IRBlock* b) {
+        while(a != b) {
+            while(index[a] > index[b]) a = idom[a];
+            while(index[b] > index[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        for(size_t i = 1; i < order.size(); i++) {
+            IRBlock* block = order.at(i);
+            IRBlock* newIdom = nullptr;
+            for(IRBlock* pred : block->preds) {
+                if(!idom.contains(pred)) continue;
+                newIdom = newIdom == nullptr ? pred : intersect(pred, newIdom);
+            }
+            if(newIdom != nullptr && (!idom.contains(block) || idom[block] != newIdom)) {
+                idom[block] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    return idom;
+}
+
+static bool isNumberable(const IROp op) {
+    switch(op) {
+        case IROp::CONST:
+        case IROp::GLOBAL_ADDR:
+        case IROp::STRING_ADDR:
+        case IROp::ADD:
+        case IROp::SUB:
+        case IROp::MUL:
+        case IROp::DIV:
+        case IROp::MOD:
+        case IROp::AND:
+        case IROp::OR:
+        case IROp::EQ:
+        case IROp::NE:
+        case IROp::LT:
+        case IROp::GT:
+        case IROp::LE:
+        case IROp::GE:
+        case IROp::EXTEND:
+        case IROp::PHI:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static std::string valueKey(const IRInstruction* inst) {
+    std::string key = irOpToString(inst->op);
+    key.append("|" + std::to_string(inst->sign) + "|" + std::to_string(inst->width) + "|" + std::to_string(inst->value) + "|" + inst->symbol + "|");
+
+    std::vector<int> ids;
+    for(const IRInstruction* operand : inst->operands) {
+        ids.push_back(operand->id);
+    }
+    if(inst->op == IROp::PHI) {
+        // phis are only equal within one block and only edge by edge
+        key.append("B" + std::to_string(inst->block->id) + "|");
+        for(size_t i = 0; i < ids.size(); i++) {
+            key.append(std::to_string(inst->incoming.at(i)->id) + ":" + std::to_string(ids.at(i)) + ",");
+        }
+        return key;
+    }
+    if(isCommutative(inst->op)) {
+        std::sort(ids.begin(), ids.end());
+    }
+    for(const int id : ids) {
+        key.append(std::to_string(id) + ",");
+    }
+    return key;
+}
+
+bool GlobalValueNumbering::run(IRFunction* function) {
+    function->recomputeCFG();
+    std::map<IRBlock*, IRBlock*> idom = computeDominators(function);
+
+    std::map<IRBlock*, std::vector<IRBlock*>> children;
+    for(IRBlock* block : function->blocks) {
+        if(idom.contains(block) && idom[block] != block) {
+            children[idom[block]].push_back(block);
+        }
+    }
+
+    bool changed = false;
+    std::map<std::string, IRInstruction*> table;
+
+    // walk the dominator tree, scoping the table so a value is only reused
+    // where its definition dominates
+    std::vector<std::pair<IRBlock*, bool>> stack = {{function->blocks.front(), false}};
+    std::vector<std::vector<std::string>> added;
+    while(!stack.empty()) {
+        auto [block, done] = stack.back();
+        stack.pop_back();
+
+        if(done) {
+            for(const std::string& key : added.back()) {
+                table.erase(key);
+            }
+            added.pop_back();
+            continue;
+        }
+
+        added.emplace_back();
+        const std::vector<IRInstruction*> instructions = block->instructions;
+        for(IRInstruction* inst : instructions) {
+            if(!isNumberable(inst->op)) continue;
+
+            const std::string key = valueKey(inst);
+            if(table.contains(key)) {
+                function->replaceAllUsesWith(inst, table.find(key)->second);
+                function->erase(inst);
+                changed = true;
+                continue;
+            }
+            table[key] = inst;
+            added.back().push_back(key);
+        }
+
+        stack.emplace_back(block, true);
+        for(IRBlock* child : children[block]) {
+            stack.emplace_back(child, false);
+        }
+    }
+
+    return changed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+///                  SparseConditionalConstantPropagation                    ///
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct LatticeValue {
+    enum State { TOP, CONSTANT, BOTTOM } state = TOP;
+    long long value = 0;
+
+    bool operator!=(const LatticeValue& other) const {
+        return state != other.state || (state == CONSTANT && value != other.value);
+    }
+};
+
+LatticeValue meet(const LatticeValue& a, const LatticeValue& b) {
+    if(a.state == LatticeValue::TOP) return b;
+    if(b.state == LatticeValue::TOP) return a;
+    if(a.state == LatticeValue::BOTTOM || b.state == LatticeValue::BOTTOM) return {LatticeValue::BOTTOM};
+    if(a.value != b.value) return {LatticeValue::BOTTOM};
+    return a;
+}
+
+// The block a switch jumps to for a known value.
+IRBlock* switchTarget(const IRInstruction* inst, const long long value) {
+    for(size_t i = 0; i < inst->cases.size(); i++) {
+        if(inst->cases.at(i) == value) return inst->targets.at(i + 1);
+    }
+    return inst->targets.front();
+}
+
+}
+
+bool SparseConditionalConstantPropagation::run(IRFunction* function) {
+    function->recomputeCFG();
+
+    std::map<IRInstruction*, LatticeValue> lattice;
+    std::map<IRInstruction*, std::vector<IRInstruction*>> users;
+    for(const IRBlock* block : function->blocks) {
+        for(IRInstruction* inst : block->instructions) {
+            for(IRInstruction* operand : inst->operands) {
+                users[operand].push_back(inst);
+            }
+        }
+    }
+
+    std::set<std::pair<IRBlock*, IRBlock*>> executableEdges;
+    std::set<IRBlock*> executableBlocks;
+    std::deque<std::pair<IRBlock*, IRBlock*>> flowWorklist = {{nullptr, function->blocks.front()}};
+    std::deque<IRInstruction*> ssaWorklist;
+
+    auto evaluate = [&](IRInstruction* inst) {
+        LatticeValue result;
+        switch(inst->op) {
+            case IROp::CONST:
+                result = {LatticeValue::CONSTANT, inst->value};
+                break;
+            case IROp::PHI:
+                for(size_t i = 0; i < inst->operands.size(); i++) {
+                    if(!executableEdges.contains({inst->incoming.at(i), inst->block})) continue;
+                    result = meet(result, lattice[inst->operands.at(i)]);
+                }
+                break;
+            case IROp::COND_BR: {
+                const LatticeValue cond = lattice[inst->operands.front()];
+                if(cond.state == LatticeValue::CONSTANT) {
+                    flowWorklist.emplace_back(inst->block, inst->targets.at(cond.value != 0 ? 0 : 1));
+                }
+                else if(cond.state == LatticeValue::BOTTOM) {
+                    flowWorklist.emplace_back(inst->block, inst->targets.at(0));
+                    flowWorklist.emplace_back(inst->block, inst->targets.at(1));
+                }
+                return;
+            }
+            case IROp::SWITCH: {
+                const LatticeValue value = lattice[inst->operands.front()];
+                if(value.state == LatticeValue::CONSTANT) {
+                    flowWorklist.emplace_back(inst->block, switchTarget(inst, value.value));
+                }
+                else if(value.state == LatticeValue::BOTTOM) {
+                    for(IRBlock* target : inst->targets) flowWorklist.emplace_back(inst->block, target);
+                }
+                return;
+            }
+            case IROp::BR:
+                flowWorklist.emplace_back(inst->block, inst->targets.front());
+                return;
+            case IROp::RET:
+            case IROp::STORE:
+                return;
+            case IROp::PARAM:
+            case IROp::GLOBAL_ADDR:
+            case IROp::STRING_ADDR:
+            case IROp::LOAD:
+            case IROp::CALL:
+            case IROp::SYSCALL:
+                result = {LatticeValue::BOTTOM};
+                break;
+            default: {
+                const LatticeValue left = lattice[inst->operands.at(0)];
+                const LatticeValue right = inst->operands.size() > 1 ? lattice[inst->operands.at(1)] : LatticeValue{LatticeValue::CONSTANT, 0};
+                if(left.state == LatticeValue::BOTTOM || right.state == LatticeValue::BOTTOM) {
+                    result = {LatticeValue::BOTTOM};
+                }
+                else if(left.state == LatticeValue::CONSTANT && right.state == LatticeValue::CONSTANT) {
+                    long long value;
+                    if(foldConstant(inst->op, inst->sign, inst->width, left.value, right.value, value)) {
+                        result = {LatticeValue::CONSTANT, value};
+                    }
+                    else {
+                        result = {LatticeValue::BOTTOM};
+                    }
+                }
+                break;
+            }
+        }
+
+        if(lattice[inst] != result) {
+            lattice[inst] = result;
+            for(IRInstruction* user : users[inst]) {
+                if(executableBlocks.contains(user->block)) ssaWorklist.push_back(user);
+            }
+        }
+    };
+
+    while(!flowWorklist.empty() || !ssaWorklist.empty()) {
+        while(!flowWorklist.empty()) {
+            const auto edge = flowWorklist.front();
+            flowWorklist.pop_front();
+            if(!executableEdges.insert(edge).second) continue;
+
+            IRBlock* block = edge.second;
+            if(executableBlocks.insert(block).second) {
+                for(IRInstruction* inst : block->instructions) evaluate(inst);
+            }
+            else {
+                for(IRInstruction* inst : block->instructions) {
+                    if(inst->op == IROp::PHI) evaluate(inst);
+                }
+            }
+        }
+        while(!ssaWorklist.empty()) {
+            IRInstruction* inst = ssaWorklist.front();
+            ssaWorklist.pop_front();
+            evaluate(inst);
+        }
+    }
+
+    bool changed = false;
+    for(IRBlock* block : function->blocks) {
+        if(!executableBlocks.contains(block)) continue;
+
+        const std::vector<IRInstruction*> instructions = block->instructions;
+        for(size_t i = 0; i < instructions.size(); i++) {
+            IRInstruction* inst = instructions.at(i);
+            const LatticeValue value = lattice[inst];
+
+            if(inst->op == IROp::SWITCH && lattice[inst->operands.front()].state == LatticeValue::CONSTANT) {
+                inst->targets = {switchTarget(inst, lattice[inst->operands.front()].value)};
+                inst->op = IROp::BR;
+                inst->cases.clear();
+                inst->operands.clear();
+                changed = true;
+                continue;
+            }
+
+            if(inst->op == IROp::COND_BR && lattice[inst->operands.front()].state == LatticeValue::CONSTANT) {
+                const bool taken = lattice[inst->operands.front()].value != 0;
+                inst->op = IROp::BR;
+                inst->targets = {inst->targets.at(taken ? 0 : 1)};
+                inst->operands.clear();
+                changed = true;
+                continue;
+            }
+
+            if(inst->op == IROp::CONST || value.state != LatticeValue::CONSTANT || hasSideEffects(inst->op)) continue;
+
+            auto* folded = new IRInstruction(IROp::CONST);
+            folded->value = value.value;
+            const auto position = std::find(block->instructions.begin(), block->instructions.end(), inst) - block->instructions.begin();
+            // constants may not be placed above the phis of a block
+            size_t index = position;
+            while(index < block->instructions.size() && block->instructions.at(index)->op == IROp::PHI) index++;
+            function->insert(block, index, folded);
+            function->replaceAllUsesWith(inst, folded);
+            function->erase(inst);
+            changed = true;
+        }
+    }
+
+    changed |= function->removeUnreachableBlocks();
+    return changed;
+}
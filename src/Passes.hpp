@@ -0,0 +1,62 @@
+#ifndef PASSES_HPP
+#define PASSES_HPP
+
+#include <string>
+#include <vector>
+
+#include "IR.hpp"
+
+class Pass {
+public:
+    virtual ~Pass() = default;
+    [[nodiscard]] virtual std::string getName() const = 0;
+
+    // returns true if the function was changed
+    virtual bool run(IRFunction* function) = 0;
+};
+
+// Runs passes over a function in the order they were added.
+class PassManager {
+public:
+    PassManager() = default;
+    ~PassManager();
+
+    void addPass(Pass* pass);
+    void addStandardPasses();
+    void setPrintAfterEach(const bool print) { printAfterEach = print; }
+
+    bool run(IRFunction* function) const;
+
+private:
+    std::vector<Pass*> passes;
+    bool printAfterEach = false;
+};
+
+// Removes unreachable blocks and every instruction whose value is never used
+// and that has no side effects.
+class DeadCodeElimination final : public Pass {
+public:
+    [[nodiscard]] std::string getName() const override { return "dce"; }
+    bool run(IRFunction* function) override;
+};
+
+// Dominator-based global value numbering: an instruction computing the same
+// pure value as one in a dominating position is replaced by it.
+class GlobalValueNumbering final : public Pass {
+public:
+    [[nodiscard]] std::string getName() const override { return "gvn"; }
+    bool run(IRFunction* function) override;
+};
+
+// Wegman-Zadeck sparse conditional constant propagation. Folds constants
+// through phis along executable edges only and turns branches on constant
+// conditions into jumps.
+class SparseConditionalConstantPropagation final : public Pass {
+public:
+    [[nodiscard]] std::string getName() const override { return "sccp"; }
+    bool run(IRFunction* function) override;
+};
+
+bool foldConstant(IROp op, bool sign, int width, long long left, long long right, long long& result);
+
+#endif
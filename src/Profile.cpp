@@ -0,0 +1,109 @@
+#include "Profile.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+
+const std::string MAGIC = "GLPROF01";
+const std::string KEYS_LABEL = "__glang_profile_keys";
+const std::string COUNTERS_LABEL = "__glang_profile_counters";
+const std::string PATH_LABEL = "__glang_profile_path";
+
+static uint64_t readU64(const std::string& data, const size_t at) {
+    uint64_t value = 0;
+    for(int i = 7; i >= 0; i--) {
+        value = value << 8 | static_cast<unsigned char>(data.at(at + i));
+    }
+    return value;
+}
+
+static std::string bytesOf(uint64_t value) {
+    std::string out;
+    for(int i = 0; i < 8; i++) {
+        if(i > 0) out.append(", ");
+        out.append(std::to_string(value & 0xff));
+        value >>= 8;
+    }
+    return out;
+}
+
+bool Profile::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if(!file) return false;
+    const std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if(data.size() < 24 || data.compare(0, MAGIC.size(), MAGIC) != 0) return false;
+    const uint64_t number = readU64(data, 8);
+    const uint64_t tableSize = readU64(data, 16);
+    if(data.size() != 24 + tableSize + number * 8) return false;
+
+    size_t at = 24;
+    for(uint64_t i = 0; i < number; i++) {
+        const size_t end = data.find('\0', at);
+        if(end == std::string::npos || end >= 24 + tableSize) return false;
+        counts[data.substr(at, end - at)] = static_cast<long long>(readU64(data, 24 + tableSize + i * 8));
+        at = end + 1;
+    }
+    loaded = true;
+    return true;
+}
+
+std::optional<long long> Profile::count(const std::string& key) const {
+    if(!counts.contains(key)) return std::nullopt;
+    return counts.find(key)->second;
+}
+
+std::string Profile::counter(const std::string& key) {
+    if(!indices.contains(key)) {
+        indices.insert({key, keys.size()});
+        keys.push_back(key);
+    }
+    return "qword [" + COUNTERS_LABEL + " + " + std::to_string(indices.find(key)->second * 8) + "]";
+}
+
+size_t Profile::tableSize() const {
+    size_t size = 0;
+    for(const std::string& key : keys) size += key.size() + 1;
+    return size;
+}
+
+std::vector<OpCode*> Profile::defineKeys(const std::string& path) const {
+    std::string value = "\"" + MAGIC + "\", " + bytesOf(keys.size()) + ", " + bytesOf(tableSize());
+    for(const std::string& key : keys) {
+        value.append(", \"" + key + "\", 0");
+    }
+    return {new DefineVar(KEYS_LABEL, "db", value), new DefineVar(PATH_LABEL, "db", "\"" + path + "\", 0")};
+}
+
+std::vector<OpCode*> Profile::defineCounters() const {
+    return {new DefineVar(COUNTERS_LABEL, "resq", std::to_string(keys.size()))};
+}
+
+// open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), two writes and a close;
+// a profile that can't be opened is silently dropped.
+std::vector<OpCode*> Profile::emitDump() const {
+    return {
+        new Move("rax", "2"),
+        new Move("rdi", PATH_LABEL),
+        new Move("esi", "577"),
+        new Move("edx", "420"),
+        new Syscall(),
+        new Test("rax", "rax"),
+        new Jump("js", "_start.profile_done"),
+        new Move("r12", "rax"),
+        new Move("rax", "1"),
+        new Move("rdi", "r12"),
+        new Move("rsi", KEYS_LABEL),
+        new Move("rdx", std::to_string(24 + tableSize())),
+        new Syscall(),
+        new Move("rax", "1"),
+        new Move("rdi", "r12"),
+        new Move("rsi", COUNTERS_LABEL),
+        new Move("rdx", std::to_string(keys.size() * 8)),
+        new Syscall(),
+        new Move("rax", "3"),
+        new Move("rdi", "r12"),
+        new Syscall(),
+        new Label(".profile_done"),
+    };
+}
@@ -0,0 +1,52 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "OpCode.hpp"
+
+// Execution counts keyed by program point: "<function>" for the entry,
+// "<function>:if<n>:then" / ":else" for the arms of the n-th if and
+// "<function>:while<n>" for the back-edge of the n-th while loop.
+//
+// Instrumented builds give every key a 64 bit counter in .bss; _start
+// writes them to the profile file when main returns. The file holds the
+// magic "GLPROF01", the number of counters and the byte size of the key
+// table as 64 bit little endian values, then the NUL terminated keys and
+// finally the counters.
+//
+// The keys are points of the AST backend. With -O a loaded profile only
+// moves the functions that never ran behind the others; if/else order,
+// cold bodies and loop alignment are decided without it.
+class Profile {
+public:
+    // Reads a profile written by an instrumented build. Returns false if
+    // the file is missing or malformed.
+    bool load(const std::string& path);
+    [[nodiscard]] bool isLoaded() const { return loaded; }
+    [[nodiscard]] std::optional<long long> count(const std::string& key) const;
+
+    // Memory operand of the counter for key, created on first use.
+    std::string counter(const std::string& key);
+    [[nodiscard]] bool hasCounters() const { return !keys.empty(); }
+    // .rodata: the file header, keys and the path the profile goes to
+    [[nodiscard]] std::vector<OpCode*> defineKeys(const std::string& path) const;
+    // .bss
+    [[nodiscard]] std::vector<OpCode*> defineCounters() const;
+    // Code for _start that writes the profile; clobbers everything but rbx
+    // and rsp.
+    [[nodiscard]] std::vector<OpCode*> emitDump() const;
+
+private:
+    [[nodiscard]] size_t tableSize() const;
+
+    std::vector<std::string> keys;
+    std::map<std::string, size_t> indices;
+    std::map<std::string, long long> counts;
+    bool loaded = false;
+};
+
+#endif
@@ -18,7 +18,9 @@ ScratchAllocator::ScratchAllocator()
 
 int ScratchAllocator::allocate()
 {
-    for(int i = 0; i < std::size(REGS); i++) {
+    const int callerSavedOrder[] = {1, 2, 0, 3, 4, 5, 6};
+    for(int n = 0; n < std::size(REGS); n++) {
+        const int i = callerSavedFirst ? callerSavedOrder[n] : n;
         if(!used[i]) {
             used[i] = true;
             if(!wasUsed[i] && std::find(std::begin(TO_PRESERVE), std::end(TO_PRESERVE), i) != std::end(TO_PRESERVE))
@@ -30,6 +32,19 @@ int ScratchAllocator::allocate()
     return -1;
 }
 
+int ScratchAllocator::allocateCalleeSaved()
+{
+    for(int i : TO_PRESERVE) {
+        if(!used[i]) {
+            used[i] = true;
+            wasUsed[i] = true;
+            return i;
+        }
+    }
+
+    return allocate();
+}
+
 void ScratchAllocator::free(const int reg)
 {
     used[reg] = false;
@@ -19,13 +19,19 @@ public:
     ~ScratchAllocator() = default;
 
     int allocate();
+    // For values that have to survive a call; falls back to allocate().
+    int allocateCalleeSaved();
     void free(int reg);
     static std::string getReg(const int reg) { return REGS[reg]; }
     static std::string getReg32(const int reg) { return REGS32[reg]; }
     static std::string getReg16(const int reg) { return REGS16[reg]; }
     static std::string getReg8(const int reg) { return REGS8[reg]; }
     bool* getWasUsed() { return wasUsed; }
+    // Hand out caller-saved registers first; only safe when no call clobbers them.
+    void preferCallerSaved(const bool prefer) { callerSavedFirst = prefer; }
 private:
+    bool callerSavedFirst = false;
+
     bool used[std::size(REGS)];
 
     bool wasUsed[std::size(REGS)];
@@ -0,0 +1,94 @@
+#include "StringPool.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+std::string StringPool::intern(const std::string& value) {
+    const std::string bytes = decode(value);
+    if(!labels.contains(bytes)) {
+        labels.insert({bytes, "string_" + std::to_string(values.size())});
+        values.push_back(bytes);
+    }
+    return labels.find(bytes)->second;
+}
+
+// Sorting the reversed strings puts every string right in front of the ones
+// it is a suffix of, so each string is merged into the owner of its
+// successor if it is a suffix of that. An owner is then emitted as one db
+// run per label it contains, only the last one NUL terminated.
+std::vector<OpCode*> StringPool::define() const {
+    std::vector<std::string> reversed;
+    for(const std::string& value : values) {
+        reversed.emplace_back(value.rbegin(), value.rend());
+    }
+    std::vector<size_t> order(values.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return reversed.at(a) < reversed.at(b);
+    });
+
+    std::vector<size_t> owner(values.size());
+    for(size_t i = order.size(); i-- > 0;) {
+        const size_t id = order.at(i);
+        owner.at(id) = id;
+        if(i + 1 < order.size() && reversed.at(order.at(i + 1)).starts_with(reversed.at(id))) {
+            owner.at(id) = owner.at(order.at(i + 1));
+        }
+    }
+
+    std::vector<OpCode*> out;
+    for(size_t id = 0; id < values.size(); id++) {
+        if(owner.at(id) != id) continue;
+        const std::string& bytes = values.at(id);
+
+        std::vector<std::pair<size_t, size_t>> members;     // offset, label number
+        for(size_t other = 0; other < values.size(); other++) {
+            if(owner.at(other) == id) members.emplace_back(bytes.size() - values.at(other).size(), other);
+        }
+        std::sort(members.begin(), members.end());
+        for(size_t i = 0; i < members.size(); i++) {
+            const size_t start = members.at(i).first;
+            const size_t end = i + 1 < members.size() ? members.at(i + 1).first : bytes.size();
+            out.push_back(new DefineVar("string_" + std::to_string(members.at(i).second), "db",
+                                        encode(bytes.substr(start, end - start), i + 1 == members.size())));
+        }
+    }
+    return out;
+}
+
+std::string StringPool::decode(const std::string& value) {
+    std::string bytes;
+    for(size_t i = 0; i < value.size(); i++) {
+        if(value.at(i) == '\\' && i + 1 < value.size() && value.at(i + 1) == 'n') {
+            bytes.push_back('\n');
+            i++;
+        } else {
+            bytes.push_back(value.at(i));
+        }
+    }
+    return bytes;
+}
+
+// Printable runs are quoted, every other byte is written as a number.
+std::string StringPool::encode(const std::string& bytes, const bool terminate) {
+    std::vector<std::string> parts;
+    std::string run;
+    for(const char c : bytes) {
+        if(c >= ' ' && c <= '~' && c != '"') {
+            run.push_back(c);
+            continue;
+        }
+        if(!run.empty()) parts.push_back("\"" + run + "\"");
+        run.clear();
+        parts.push_back(std::to_string(static_cast<unsigned char>(c)));
+    }
+    if(!run.empty()) parts.push_back("\"" + run + "\"");
+    if(terminate) parts.emplace_back("0");
+
+    std::string out;
+    for(const std::string& part : parts) {
+        if(!out.empty()) out.append(", ");
+        out.append(part);
+    }
+    return out;
+}
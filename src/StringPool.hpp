@@ -0,0 +1,29 @@
+#ifndef STRING_POOL_HPP
+#define STRING_POOL_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "OpCode.hpp"
+
+// Module-wide pool of string literals. Identical literals share one label
+// and a literal that ends another one points into it. Labels are numbered
+// in order of first use and the pool is emitted once into .rodata.
+class StringPool {
+public:
+    // Returns the label of the NUL terminated bytes of value; only the \n
+    // escape is decoded.
+    std::string intern(const std::string& value);
+
+    [[nodiscard]] std::vector<OpCode*> define() const;
+
+private:
+    static std::string decode(const std::string& value);
+    static std::string encode(const std::string& bytes, bool terminate);
+
+    std::map<std::string, std::string> labels;
+    std::vector<std::string> values;    // decoded bytes by label number
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "Switch.hpp"
+#include "AST.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// A run of at least TABLE_MIN_CASES values is dispatched through a table if
+// at least every TABLE_MIN_DENSITY-th slot of the table is a case; runs of
+// up to LINEAR_MAX_CASES values are compared one by one.
+const size_t TABLE_MIN_CASES = 4;
+const size_t TABLE_MIN_DENSITY = 3;
+const unsigned long long TABLE_MAX_SIZE = 4096;
+const size_t LINEAR_MAX_CASES = 3;
+
+SwitchEmitter::SwitchEmitter(std::vector<OpCode*>& textSegment, std::vector<OpCode*>& roSegment, const std::string& function, const int index)
+    : textSegment(textSegment), roSegment(roSegment) {
+    this->function = function;
+    this->index = index;
+}
+
+std::vector<long long> SwitchEmitter::wrapCases(const Switch* stmt, const int width, const bool sign) {
+    std::vector<long long> values;
+    std::set<long long> seen;
+    for(const Switch::Case& c : stmt->cases) {
+        for(const long long value : c.values) {
+            unsigned long long wrapped = static_cast<unsigned long long>(value);
+            if(width < 8) {
+                const int bits = width * 8;
+                const unsigned long long mask = (1ULL << bits) - 1;
+                wrapped &= mask;
+                if(sign && (wrapped >> (bits - 1)) != 0) wrapped |= ~mask;
+            }
+            if(!seen.insert(static_cast<long long>(wrapped)).second) {
+                throw std::runtime_error(stmt->path + ":" + std::to_string(stmt->lineNum) + ": case " + std::to_string(value)
+                    + " is the same as another case once wrapped to " + std::to_string(width * 8) + " bits");
+            }
+            values.push_back(static_cast<long long>(wrapped));
+        }
+    }
+    return values;
+}
+
+void SwitchEmitter::emit(const std::string& reg, const std::string& scratch, std::vector<Case> cases, const std::string& fallback, const bool sign) {
+    this->reg = reg;
+    this->scratch = scratch;
+    this->fallback = fallback;
+    this->sign = sign;
+    std::sort(cases.begin(), cases.end(), [sign](const Case& a, const Case& b) {
+        if(sign) return a.value < b.value;
+        return static_cast<unsigned long long>(a.value) < static_cast<unsigned long long>(b.value);
+    });
+    this->cases = cases;
+
+    if(cases.empty()) {
+        textSegment.push_back(new Jump("jmp", fallback));
+        return;
+    }
+
+    // greedily cut the sorted values into the longest dense runs, the
+    // values in between stay clusters of their own
+    clusters.clear();
+    for(size_t begin = 0; begin < cases.size();) {
+        size_t end = begin + 1;
+        for(size_t last = cases.size(); last >= begin + TABLE_MIN_CASES; last--) {
+            if(isDense(begin, last)) {
+                end = last;
+                break;
+            }
+        }
+        clusters.emplace_back(begin, end);
+        begin = end;
+    }
+    emitNode(0, clusters.size());
+}
+
+// Splits the clusters [begin, end) in half: values below the first value of
+// the middle cluster go to the left subtree, the rest falls through into the
+// right one.
+void SwitchEmitter::emitNode(const size_t begin, const size_t end) {
+    if(end - begin == 1 && clusters.at(begin).second - clusters.at(begin).first > 1) {
+        emitTable(clusters.at(begin).first, clusters.at(begin).second);
+        return;
+    }
+    const size_t values = clusters.at(end - 1).second - clusters.at(begin).first;
+    if(values == end - begin && values <= LINEAR_MAX_CASES) {
+        for(size_t i = clusters.at(begin).first; i < clusters.at(end - 1).second; i++) {
+            compare(cases.at(i).value);
+            textSegment.push_back(new Jump("je", cases.at(i).target));
+        }
+        textSegment.push_back(new Jump("jmp", fallback));
+        return;
+    }
+
+    const size_t mid = begin + (end - begin) / 2;
+    const std::string left = label("node" + std::to_string(nodeIndex++));
+    compare(cases.at(clusters.at(mid).first).value);
+    textSegment.push_back(new Jump(sign ? "jl" : "jb", function + left));
+    emitNode(mid, end);
+    textSegment.push_back(new Label(left));
+    emitNode(begin, mid);
+}
+
+void SwitchEmitter::emitTable(const size_t begin, const size_t end) {
+    const long long low = cases.at(begin).value;
+    const unsigned long long span = static_cast<unsigned long long>(cases.at(end - 1).value) - static_cast<unsigned long long>(low);
+    const std::string table = function + label("table" + std::to_string(tableIndex++));
+
+    std::string entries;
+    size_t next = begin;
+    for(unsigned long long i = 0; i <= span; i++) {
+        const long long value = static_cast<long long>(static_cast<unsigned long long>(low) + i);
+        if(!entries.empty()) entries.append(", ");
+        if(next < end && cases.at(next).value == value) entries.append(cases.at(next++).target);
+        else entries.append(fallback);
+    }
+    roSegment.push_back(new DefineVar(table, "dq", entries));
+
+    // rebase to 0 so a single unsigned compare rejects both sides of the range
+    if(low != 0) {
+        if(low >= INT_MIN && low <= INT_MAX) {
+            textSegment.push_back(new Sub(reg, std::to_string(low)));
+        } else {
+            textSegment.push_back(new Move(scratch, std::to_string(low)));
+            textSegment.push_back(new Sub(reg, scratch));
+        }
+    }
+    textSegment.push_back(new Compare(reg, std::to_string(span)));
+    textSegment.push_back(new Jump("ja", fallback));
+    textSegment.push_back(new Jump("jmp", "[" + table + " + " + reg + " * 8]"));
+}
+
+void SwitchEmitter::compare(const long long value) {
+    if(value >= INT_MIN && value <= INT_MAX) {
+        textSegment.push_back(new Compare(reg, std::to_string(value)));
+        return;
+    }
+    textSegment.push_back(new Move(scratch, std::to_string(value)));
+    textSegment.push_back(new Compare(reg, scratch));
+}
+
+bool SwitchEmitter::isDense(const size_t begin, const size_t end) const {
+    const size_t count = end - begin;
+    if(count < TABLE_MIN_CASES) return false;
+    const unsigned long long span = static_cast<unsigned long long>(cases.at(end - 1).value) - static_cast<unsigned long long>(cases.at(begin).value);
+    return span < TABLE_MAX_SIZE && span + 1 <= count * TABLE_MIN_DENSITY;
+}
+
+std::string SwitchEmitter::label(const std::string& name) const {
+    return ".switch" + std::to_string(index) + "_" + name;
+}
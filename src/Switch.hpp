@@ -0,0 +1,55 @@
+#ifndef SWITCH_HPP
+#define SWITCH_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "OpCode.hpp"
+
+class Switch;
+
+// Dispatch code for switch statements. Dense runs of case values become a
+// jump table in .rodata, everything else a balanced tree of compares.
+class SwitchEmitter {
+public:
+    struct Case {
+        long long value;
+        std::string target;
+    };
+
+    SwitchEmitter(std::vector<OpCode*>& textSegment, std::vector<OpCode*>& roSegment, const std::string& function, int index);
+
+    // The case values of stmt in order, as a switch value of width bytes
+    // sees them: wrapped to that width and sign extended back to 64 bits if
+    // sign is set. Values the parser saw as different, like 44 and 300 for
+    // a u8, can end up the same; that is an error.
+    static std::vector<long long> wrapCases(const Switch* stmt, int width, bool sign);
+
+    // reg holds the value extended to 64 bits, signed if sign is set. reg and
+    // scratch are clobbered; values without a case jump to fallback.
+    void emit(const std::string& reg, const std::string& scratch, std::vector<Case> cases, const std::string& fallback, bool sign);
+
+private:
+    void emitNode(size_t begin, size_t end);
+    void emitTable(size_t begin, size_t end);
+    void compare(long long value);
+    [[nodiscard]] bool isDense(size_t begin, size_t end) const;
+    [[nodiscard]] std::string label(const std::string& name) const;
+
+    std::vector<OpCode*>& textSegment;
+    std::vector<OpCode*>& roSegment;
+    std::string function;
+    int index;
+
+    std::string reg;
+    std::string scratch;
+    std::vector<Case> cases;
+    std::vector<std::pair<size_t, size_t>> clusters;   // [begin, end) into cases
+    std::string fallback;
+    bool sign = false;
+    int nodeIndex = 0;
+    int tableIndex = 0;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "TimeReport.hpp"
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+#include <sys/resource.h>
+
+static unsigned long long allocationCount = 0;
+
+void* operator new(const std::size_t size) {
+    allocationCount++;
+    if(void* p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](const std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+static long peakRss() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// JSON string contents; names are paths and identifiers, so only quotes
+// and backslashes need escaping.
+static std::string escape(const std::string& value) {
+    std::string out;
+    for(const char c : value) {
+        if(c == '"' || c == '\\') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+TimeReport::Region::Region(TimeReport* report, const std::string& name, const std::string& category) {
+    this->report = report != nullptr && report->enabled ? report : nullptr;
+    if(this->report == nullptr) return;
+    event = this->report->events.size();
+    this->report->events.push_back(Event{name, category, this->report->depth++, this->report->now(), 0, allocationCount, 0});
+}
+
+TimeReport::Region::~Region() {
+    if(report == nullptr) return;
+    Event& e = report->events.at(event);
+    e.duration = report->now() - e.start;
+    e.allocations = allocationCount - e.allocations;
+    e.peakRss = peakRss();
+    report->depth--;
+}
+
+unsigned long long TimeReport::allocations() {
+    return allocationCount;
+}
+
+double TimeReport::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void TimeReport::print(std::ostream& out) const {
+    out << "===-- glang time report --===" << std::endl;
+    out << std::setw(12) << "wall (ms)" << std::setw(12) << "allocs" << std::setw(16) << "peak RSS (KiB)" << "  name" << std::endl;
+    for(const Event& e : events) {
+        out << std::fixed << std::setprecision(3) << std::setw(12) << e.duration / 1000.0
+            << std::setw(12) << e.allocations << std::setw(16) << e.peakRss << "  "
+            << std::string(e.depth * 2, ' ') << e.name << std::endl;
+    }
+}
+
+bool TimeReport::writeTrace(const std::string& path) const {
+    std::ofstream out(path);
+    if(!out) return false;
+    out << "{\"traceEvents\":[" << std::endl;
+    for(size_t i = 0; i < events.size(); i++) {
+        const Event& e = events.at(i);
+        out << std::fixed << std::setprecision(3)
+            << "{\"name\":\"" << escape(e.name) << "\",\"cat\":\"" << e.category << "\",\"ph\":\"X\""
+            << ",\"ts\":" << e.start << ",\"dur\":" << e.duration << ",\"pid\":1,\"tid\":1"
+            << ",\"args\":{\"allocations\":" << e.allocations << ",\"peak_rss_kib\":" << e.peakRss << "}}"
+            << (i + 1 < events.size() ? "," : "") << std::endl;
+    }
+    out << "]}" << std::endl;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef TIME_REPORT_HPP
+#define TIME_REPORT_HPP
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Wall time, heap allocations and peak RSS of the compiler's own phases
+// (--time-report), optionally as a Chrome trace (--trace=out.json).
+// Regions nest: a phase contains modules, codegen contains functions.
+class TimeReport {
+public:
+    // Times the enclosing block; does nothing if report is null or disabled.
+    class Region {
+    public:
+        Region(TimeReport* report, const std::string& name, const std::string& category);
+        ~Region();
+        Region(const Region&) = delete;
+        Region& operator=(const Region&) = delete;
+
+    private:
+        TimeReport* report;
+        size_t event = 0;
+    };
+
+    void enable() { enabled = true; }
+    [[nodiscard]] bool isEnabled() const { return enabled; }
+
+    void print(std::ostream& out) const;
+    [[nodiscard]] bool writeTrace(const std::string& path) const;
+
+    // heap allocations made through operator new so far
+    static unsigned long long allocations();
+
+private:
+    struct Event {
+        std::string name;
+        std::string category;
+        int depth;
+        double start;       // microseconds since the report was created
+        double duration;
+        unsigned long long allocations;
+        long peakRss;       // KiB, at the end of the region
+    };
+
+    [[nodiscard]] double now() const;
+
+    std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+    std::vector<Event> events;
+    int depth = 0;
+    bool enabled = false;
+};
+
+#endif
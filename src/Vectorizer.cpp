@@ -0,0 +1,431 @@
+#include "Vectorizer.hpp"
+#include "IR.hpp"
+
+#include <string>
+#include <vector>
+
+static const std::string RAX[] = {"", "al", "ax", "", "eax", "", "", "", "rax"};
+static const std::string R9[] = {"", "r9b", "r9w", "", "r9d", "", "", "", "r9"};
+static const std::string SIZE[] = {"", "byte", "word", "", "dword", "", "", "", "qword"};
+
+static IdExpression* plainId(Expression* expr) {
+    auto* id = dynamic_cast<IdExpression*>(expr);
+    if(id == nullptr || id->index != nullptr || id->derefDepth != 0) return nullptr;
+    return id;
+}
+
+// Matches `name[index]` and returns the array expression.
+static IdExpression* indexedBy(Expression* expr, const std::string& index) {
+    auto* id = dynamic_cast<IdExpression*>(expr);
+    if(id == nullptr || id->index == nullptr || id->derefDepth != 0) return nullptr;
+    IdExpression* idx = plainId(id->index);
+    if(idx == nullptr || idx->id.name != index) return nullptr;
+    return id;
+}
+
+// Literals and scalar variables that the loop body does not write are
+// evaluated once before the loop.
+static bool isInvariant(Expression* expr, const std::vector<std::string>& written) {
+    if(expr->derefDepth != 0) return false;
+    if(dynamic_cast<IntLit*>(expr) != nullptr || dynamic_cast<CharLit*>(expr) != nullptr) return true;
+    IdExpression* id = plainId(expr);
+    if(id == nullptr) return false;
+    for(const std::string& name : written) {
+        if(name == id->id.name) return false;
+    }
+    return true;
+}
+
+// Matches `name = name + step` and `name = step + name`.
+static bool isStep(Statement* stmt, const std::string& name, const int step) {
+    auto* assign = dynamic_cast<VarAssignment*>(stmt);
+    if(assign == nullptr) return false;
+    IdExpression* lhs = plainId(assign->lhs);
+    auto* rhs = dynamic_cast<BinaryExpression*>(assign->rhs);
+    if(lhs == nullptr || lhs->id.name != name || rhs == nullptr) return false;
+    if(rhs->op != BinaryOperator::PLUS || rhs->derefDepth != 0) return false;
+
+    IdExpression* id = plainId(rhs->left);
+    auto* lit = dynamic_cast<IntLit*>(rhs->right);
+    if(id == nullptr) {
+        id = plainId(rhs->right);
+        lit = dynamic_cast<IntLit*>(rhs->left);
+    }
+    return id != nullptr && lit != nullptr && id->id.name == name && lit->value == step && lit->derefDepth == 0;
+}
+
+static std::vector<Statement*> bodyStatements(Statement* body) {
+    std::vector<Statement*> statements;
+    if(auto* compound = dynamic_cast<Compound*>(body)) {
+        for(Statement* stmt : compound->statements) {
+            if(dynamic_cast<EndCompound*>(stmt) == nullptr) statements.push_back(stmt);
+        }
+        return statements;
+    }
+    return {body};
+}
+
+static bool isInteger(const TypeIdentifierType type) {
+    return type != TypeIdentifierType::VOID && type != TypeIdentifierType::F32 && type != TypeIdentifierType::F64;
+}
+
+static bool isWordInteger(const std::optional<TypeIdentifier>& type) {
+    return type.has_value() && type->ptrDepth == 0 && (type->type == TypeIdentifierType::I64 || type->type == TypeIdentifierType::U64);
+}
+
+// Element size of a pointer to integers, or 0.
+static int elementSize(const std::optional<TypeIdentifier>& type) {
+    if(!type.has_value() || type->ptrDepth != 1 || !isInteger(type->type)) return 0;
+    return typeWidth(TypeIdentifier{type->type, 0});
+}
+
+static IdExpression* base(IdExpression* expr) {
+    auto* id = new IdExpression(expr->id);
+    id->lineNum = expr->lineNum;
+    id->colNum = expr->colNum;
+    id->path = expr->path;
+    return id;
+}
+
+LoopVectorizer::LoopVectorizer(std::vector<OpCode*>& textSegment, const std::string& function, const int index, const int vectorBytes) : textSegment(textSegment) {
+    this->function = function;
+    this->index = index;
+    this->vectorBytes = vectorBytes;
+    this->avx = vectorBytes == 32;
+}
+
+bool LoopVectorizer::match(While* loop, const TypeLookup& lookup, VectorLoop& out) {
+    auto* condition = dynamic_cast<BinaryExpression*>(loop->condition);
+    if(condition == nullptr || condition->derefDepth != 0) return false;
+    std::vector<Statement*> body = bodyStatements(loop->body);
+
+    // while(target[i] != value) { i = i + 1; }
+    if(condition->op == BinaryOperator::NEQUALS) {
+        auto* array = dynamic_cast<IdExpression*>(condition->left);
+        if(array == nullptr || array->index == nullptr) return false;
+        IdExpression* index = plainId(array->index);
+        if(index == nullptr || indexedBy(array, index->id.name) == nullptr) return false;
+        if(!isWordInteger(lookup(index->id)) || elementSize(lookup(array->id)) != 1) return false;
+        if(!isInvariant(condition->right, {index->id.name})) return false;
+        if(body.size() != 1 || !isStep(body[0], index->id.name, 1)) return false;
+
+        out.kind = VectorLoop::Kind::SCAN;
+        out.index = index;
+        out.target = base(array);
+        out.value = condition->right;
+        out.elementSize = 1;
+        return true;
+    }
+
+    // while(i < bound) { <payload>; i = i + size; }
+    if(condition->op != BinaryOperator::LESS) return false;
+    IdExpression* index = plainId(condition->left);
+    if(index == nullptr || !isWordInteger(lookup(index->id))) return false;
+    if(body.size() != 2) return false;
+    auto* payload = dynamic_cast<VarAssignment*>(body[0]);
+    if(payload == nullptr) return false;
+
+    out.index = index;
+    out.bound = condition->right;
+    out.signedIndex = typeSigned(*lookup(index->id));
+    std::vector<std::string> written = {index->id.name};
+
+    if(IdExpression* array = indexedBy(payload->lhs, index->id.name)) {
+        out.elementSize = elementSize(lookup(array->id));
+        out.target = base(array);
+
+        if(IdExpression* source = indexedBy(payload->rhs, index->id.name)) {
+            if(elementSize(lookup(source->id)) != out.elementSize) return false;
+            out.kind = VectorLoop::Kind::COPY;
+            out.source = base(source);
+        } else {
+            if(!isInvariant(payload->rhs, written)) return false;
+            out.kind = VectorLoop::Kind::FILL;
+            out.value = payload->rhs;
+        }
+    } else {
+        // acc = acc + target[i]
+        IdExpression* acc = plainId(payload->lhs);
+        auto* add = dynamic_cast<BinaryExpression*>(payload->rhs);
+        if(acc == nullptr || add == nullptr || add->op != BinaryOperator::PLUS || add->derefDepth != 0) return false;
+        if(!isWordInteger(lookup(acc->id)) || acc->id.name == index->id.name) return false;
+
+        IdExpression* self = plainId(add->left);
+        IdExpression* summed = indexedBy(add->right, index->id.name);
+        if(self == nullptr || summed == nullptr) {
+            self = plainId(add->right);
+            summed = indexedBy(add->left, index->id.name);
+        }
+        if(self == nullptr || summed == nullptr || self->id.name != acc->id.name) return false;
+
+        std::optional<TypeIdentifier> type = lookup(summed->id);
+        out.elementSize = elementSize(type);
+        if(out.elementSize == 0) return false;
+        // Narrow signed elements would need sign extension in every lane.
+        if(out.elementSize != 8 && typeSigned(TypeIdentifier{type->type, 0})) return false;
+
+        out.kind = VectorLoop::Kind::SUM;
+        out.target = base(summed);
+        out.accumulator = acc;
+        written.push_back(acc->id.name);
+    }
+
+    if(out.elementSize == 0) return false;
+    if(!isInvariant(out.bound, written)) return false;
+    return isStep(body[1], index->id.name, out.elementSize);
+}
+
+void LoopVectorizer::emit(const VectorLoop& loop) {
+    if(loop.kind == VectorLoop::Kind::SCAN) emitScan();
+    else emitCounted(loop);
+
+    if(avx) simd("zeroupper", "");
+}
+
+// Sentinel scans read whole aligned vectors. An aligned load never crosses a
+// page boundary, so reading past the sentinel can't fault; the bytes in
+// front of the start are shifted out of the match mask.
+void LoopVectorizer::emitScan() {
+    textSegment.push_back(new MoveExtend("movzx", "r9d", "r9b"));
+    if(avx) {
+        simd("movd", "xmm1", "r9d");
+        simd("pbroadcastb", vreg(1), "xmm1");
+    } else {
+        textSegment.push_back(new SimdOp("movd", "xmm1", "r9d"));
+        textSegment.push_back(new SimdOp("punpcklbw", "xmm1", "xmm1"));
+        textSegment.push_back(new SimdOp("pshuflw", "xmm1", "xmm1", "0"));
+        textSegment.push_back(new SimdOp("pshufd", "xmm1", "xmm1", "0"));
+    }
+
+    textSegment.push_back(new LoadEffectiveAddr("rax", "[rdi + rdx]"));
+    textSegment.push_back(new Move("rcx", "rax"));
+    textSegment.push_back(new AND("rcx", std::to_string(vectorBytes - 1)));
+    textSegment.push_back(new AND("rax", std::to_string(-vectorBytes)));
+    simd("movdqa", vreg(0), "[rax]");
+    arith("pcmpeqb", vreg(0), vreg(1));
+    simd("pmovmskb", "r9d", vreg(0));
+    textSegment.push_back(new Shift("shr", "r9d", "cl"));
+    textSegment.push_back(new Test("r9d", "r9d"));
+    textSegment.push_back(new Jump("jnz", target("head")));
+
+    textSegment.push_back(new Align(CODE_ALIGNMENT));
+    textSegment.push_back(new Label(label("loop")));
+    textSegment.push_back(new Add("rax", std::to_string(vectorBytes)));
+    simd("movdqa", vreg(0), "[rax]");
+    arith("pcmpeqb", vreg(0), vreg(1));
+    simd("pmovmskb", "r9d", vreg(0));
+    textSegment.push_back(new Test("r9d", "r9d"));
+    textSegment.push_back(new Jump("jz", target("loop")));
+
+    textSegment.push_back(new BitScan("bsf", "r9d", "r9d"));
+    textSegment.push_back(new Add("rax", "r9"));
+    textSegment.push_back(new Sub("rax", "rdi"));
+    textSegment.push_back(new Move("rdx", "rax"));
+    textSegment.push_back(new Jump("jmp", target("done")));
+
+    textSegment.push_back(new Label(label("head")));
+    textSegment.push_back(new BitScan("bsf", "r9d", "r9d"));
+    textSegment.push_back(new Add("rdx", "r9"));
+    textSegment.push_back(new Label(label("done")));
+}
+
+// Counted loops run a scalar prologue until the target is vector aligned,
+// the vector loop while a whole vector fits below the bound and a scalar
+// epilogue for the remaining elements.
+void LoopVectorizer::emitCounted(const VectorLoop& loop) {
+    const int size = loop.elementSize;
+    const std::string bytes = std::to_string(vectorBytes);
+    const std::string less = loop.signedIndex ? "jl" : "jb";
+    const std::string greaterEqual = loop.signedIndex ? "jge" : "jae";
+    const std::string greater = loop.signedIndex ? "jg" : "ja";
+    const std::string lessEqual = loop.signedIndex ? "jle" : "jbe";
+
+    textSegment.push_back(new Compare("rdx", "rcx"));
+    textSegment.push_back(new Jump(greaterEqual, target("done")));
+
+    if(loop.kind == VectorLoop::Kind::COPY) {
+        // A target just above the source reads bytes the loop has already
+        // written, so it has to stay scalar.
+        textSegment.push_back(new Move("rax", "rdi"));
+        textSegment.push_back(new Sub("rax", "rsi"));
+        textSegment.push_back(new Compare("rax", bytes));
+        textSegment.push_back(new Jump("jb", target("scalar")));
+    }
+    if(size > 1) {
+        // Elements that aren't naturally aligned never reach vector alignment.
+        textSegment.push_back(new LoadEffectiveAddr("rax", "[rdi + rdx]"));
+        textSegment.push_back(new Test("al", std::to_string(size - 1)));
+        textSegment.push_back(new Jump("jnz", target("scalar")));
+    }
+    if(loop.kind == VectorLoop::Kind::FILL) emitBroadcast(size);
+
+    textSegment.push_back(new Label(label("peel")));
+    textSegment.push_back(new LoadEffectiveAddr("rax", "[rdi + rdx]"));
+    textSegment.push_back(new Test("al", std::to_string(vectorBytes - 1)));
+    textSegment.push_back(new Jump("jz", target("vector")));
+    emitScalarBody(loop);
+    textSegment.push_back(new Add("rdx", std::to_string(size)));
+    textSegment.push_back(new Compare("rdx", "rcx"));
+    textSegment.push_back(new Jump(less, target("peel")));
+    textSegment.push_back(new Jump("jmp", target("done")));
+
+    textSegment.push_back(new Label(label("vector")));
+    if(loop.kind == VectorLoop::Kind::SUM) {
+        arith("pxor", vreg(2), vreg(2));
+        arith("pxor", vreg(3), vreg(3));
+    }
+    textSegment.push_back(new LoadEffectiveAddr("rax", "[rdx + " + bytes + "]"));
+    textSegment.push_back(new Compare("rax", "rcx"));
+    textSegment.push_back(new Jump(greater, target("exit")));
+    textSegment.push_back(new Align(CODE_ALIGNMENT));
+    textSegment.push_back(new Label(label("loop")));
+    emitVectorBody(loop);
+    textSegment.push_back(new Move("rdx", "rax"));
+    textSegment.push_back(new Add("rax", bytes));
+    textSegment.push_back(new Compare("rax", "rcx"));
+    textSegment.push_back(new Jump(lessEqual, target("loop")));
+    textSegment.push_back(new Label(label("exit")));
+    if(loop.kind == VectorLoop::Kind::SUM) emitReduce();
+
+    textSegment.push_back(new Label(label("scalar")));
+    textSegment.push_back(new Compare("rdx", "rcx"));
+    textSegment.push_back(new Jump(greaterEqual, target("done")));
+    textSegment.push_back(new Label(label("tail")));
+    emitScalarBody(loop);
+    textSegment.push_back(new Add("rdx", std::to_string(size)));
+    textSegment.push_back(new Compare("rdx", "rcx"));
+    textSegment.push_back(new Jump(less, target("tail")));
+    textSegment.push_back(new Label(label("done")));
+}
+
+// Splats the low element of r9 across vector register 1.
+void LoopVectorizer::emitBroadcast(const int elementSize) {
+    switch(elementSize) {
+        case 1:
+            textSegment.push_back(new MoveExtend("movzx", "r9d", "r9b"));
+            textSegment.push_back(new Move("rax", "0x0101010101010101"));
+            textSegment.push_back(new Multiply("rax", "r9", true));
+            break;
+        case 2:
+            textSegment.push_back(new MoveExtend("movzx", "r9d", "r9w"));
+            textSegment.push_back(new Move("rax", "0x0001000100010001"));
+            textSegment.push_back(new Multiply("rax", "r9", true));
+            break;
+        case 4:
+            textSegment.push_back(new Move("r9d", "r9d"));
+            textSegment.push_back(new Move("rax", "0x0000000100000001"));
+            textSegment.push_back(new Multiply("rax", "r9", true));
+            break;
+        default:
+            textSegment.push_back(new Move("rax", "r9"));
+            break;
+    }
+
+    if(avx) {
+        simd("movq", "xmm1", "rax");
+        simd("pbroadcastq", vreg(1), "xmm1");
+    } else {
+        textSegment.push_back(new SimdOp("movq", "xmm1", "rax"));
+        textSegment.push_back(new SimdOp("punpcklqdq", "xmm1", "xmm1"));
+    }
+}
+
+void LoopVectorizer::emitScalarBody(const VectorLoop& loop) {
+    const int size = loop.elementSize;
+    const std::string element = SIZE[size] + " [rdi + rdx]";
+
+    switch(loop.kind) {
+        case VectorLoop::Kind::FILL:
+            textSegment.push_back(new Move(element, R9[size]));
+            break;
+        case VectorLoop::Kind::COPY:
+            textSegment.push_back(new Move(RAX[size], SIZE[size] + " [rsi + rdx]"));
+            textSegment.push_back(new Move(element, RAX[size]));
+            break;
+        case VectorLoop::Kind::SUM:
+            if(size < 4) textSegment.push_back(new MoveExtend("movzx", "eax", element));
+            else textSegment.push_back(new Move(RAX[size], element));
+            textSegment.push_back(new Add("r8", "rax"));
+            break;
+        case VectorLoop::Kind::SCAN:
+            break;
+    }
+}
+
+// rax holds the next index and must survive the body.
+void LoopVectorizer::emitVectorBody(const VectorLoop& loop) {
+    switch(loop.kind) {
+        case VectorLoop::Kind::FILL:
+            simd("movdqa", "[rdi + rdx]", vreg(1));
+            break;
+        case VectorLoop::Kind::COPY:
+            simd("movdqu", vreg(0), "[rsi + rdx]");
+            simd("movdqa", "[rdi + rdx]", vreg(0));
+            break;
+        case VectorLoop::Kind::SUM:
+            simd("movdqa", vreg(0), "[rdi + rdx]");
+            switch(loop.elementSize) {
+                case 1:
+                    // psadbw against zero sums each group of eight bytes into a qword
+                    arith("psadbw", vreg(0), vreg(3));
+                    break;
+                case 2:
+                    simd("movdqa", vreg(1), vreg(0));
+                    arith("punpcklwd", vreg(0), vreg(3));
+                    arith("punpckhwd", vreg(1), vreg(3));
+                    arith("paddd", vreg(0), vreg(1));
+                    [[fallthrough]];
+                case 4:
+                    simd("movdqa", vreg(1), vreg(0));
+                    arith("punpckldq", vreg(0), vreg(3));
+                    arith("punpckhdq", vreg(1), vreg(3));
+                    arith("paddq", vreg(2), vreg(1));
+                    break;
+                default:
+                    break;
+            }
+            arith("paddq", vreg(2), vreg(0));
+            break;
+        case VectorLoop::Kind::SCAN:
+            break;
+    }
+}
+
+// Adds the qword lanes of vector register 2 to r8.
+void LoopVectorizer::emitReduce() {
+    if(avx) {
+        textSegment.push_back(new SimdOp("vextracti128", "xmm0", "ymm2", "1"));
+        textSegment.push_back(new SimdOp("vpaddq", "xmm2", "xmm2", "xmm0"));
+        textSegment.push_back(new SimdOp("vpshufd", "xmm0", "xmm2", "0x4e"));
+        textSegment.push_back(new SimdOp("vpaddq", "xmm2", "xmm2", "xmm0"));
+        textSegment.push_back(new SimdOp("vmovq", "rax", "xmm2"));
+    } else {
+        textSegment.push_back(new SimdOp("pshufd", "xmm0", "xmm2", "0x4e"));
+        textSegment.push_back(new SimdOp("paddq", "xmm2", "xmm0"));
+        textSegment.push_back(new SimdOp("movq", "rax", "xmm2"));
+    }
+    textSegment.push_back(new Add("r8", "rax"));
+}
+
+// Two operand form; AVX uses the VEX encoding of the same instruction.
+void LoopVectorizer::simd(const std::string& mnemonic, const std::string& first, const std::string& second, const std::string& third) {
+    textSegment.push_back(new SimdOp(avx ? "v" + mnemonic : mnemonic, first, second, third));
+}
+
+// Destructive SSE arithmetic; AVX gets the non-destructive three operand form.
+void LoopVectorizer::arith(const std::string& mnemonic, const std::string& first, const std::string& second) {
+    if(avx) textSegment.push_back(new SimdOp("v" + mnemonic, first, first, second));
+    else textSegment.push_back(new SimdOp(mnemonic, first, second));
+}
+
+std::string LoopVectorizer::vreg(const int index) const {
+    return (avx ? "ymm" : "xmm") + std::to_string(index);
+}
+
+std::string LoopVectorizer::label(const std::string& name) const {
+    return ".vec" + std::to_string(index) + "_" + name;
+}
+
+std::string LoopVectorizer::target(const std::string& name) const {
+    return function + label(name);
+}
@@ -0,0 +1,72 @@
+#ifndef VECTORIZER_HPP
+#define VECTORIZER_HPP
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "AST.hpp"
+#include "OpCode.hpp"
+
+// A While loop the vectorizer understands. The induction variable is a
+// byte offset that is stepped by the element size, like every other array
+// access in glang.
+//
+//   SCAN:  while(target[i] != value) { i = i + 1; }
+//   FILL:  while(i < bound) { target[i] = value; i = i + size; }
+//   COPY:  while(i < bound) { target[i] = source[i]; i = i + size; }
+//   SUM:   while(i < bound) { acc = acc + target[i]; i = i + size; }
+struct VectorLoop {
+    enum class Kind { SCAN, FILL, COPY, SUM };
+
+    Kind kind = Kind::SCAN;
+    IdExpression* index = nullptr;
+    Expression* bound = nullptr;
+    IdExpression* target = nullptr;
+    IdExpression* source = nullptr;
+    Expression* value = nullptr;
+    IdExpression* accumulator = nullptr;
+    int elementSize = 1;
+    bool signedIndex = false;
+};
+
+// Recognizes vectorizable loops and emits SSE2 or AVX2 code for them.
+//
+// Register contract for emit(): the caller loads the target base into rdi,
+// the source base into rsi, the index into rdx, the bound into rcx, the
+// accumulator into r8 and the fill/sentinel value into r9. On exit rdx holds
+// the final index and r8 the final accumulator. rax and xmm0-xmm3 are
+// clobbered.
+class LoopVectorizer {
+public:
+    using TypeLookup = std::function<std::optional<TypeIdentifier>(const Identifier&)>;
+
+    LoopVectorizer(std::vector<OpCode*>& textSegment, const std::string& function, int index, int vectorBytes);
+
+    static bool match(While* loop, const TypeLookup& lookup, VectorLoop& out);
+
+    void emit(const VectorLoop& loop);
+
+private:
+    void emitScan();
+    void emitCounted(const VectorLoop& loop);
+    void emitBroadcast(int elementSize);
+    void emitScalarBody(const VectorLoop& loop);
+    void emitVectorBody(const VectorLoop& loop);
+    void emitReduce();
+
+    void simd(const std::string& mnemonic, const std::string& first, const std::string& second = "", const std::string& third = "");
+    void arith(const std::string& mnemonic, const std::string& first, const std::string& second);
+    [[nodiscard]] std::string vreg(int index) const;
+    [[nodiscard]] std::string label(const std::string& name) const;
+    [[nodiscard]] std::string target(const std::string& name) const;
+
+    std::vector<OpCode*>& textSegment;
+    std::string function;
+    int index;
+    int vectorBytes;
+    bool avx;
+};
+
+#endif
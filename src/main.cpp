@@ -1,16 +1,26 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <set>
 #include <string>
 
 #include "AST.hpp"
+#include "CallGraph.hpp"
 #include "Lexer.hpp"
 #include "Parser.hpp"
+#include "TimeReport.hpp"
 
 void printParseTree(const Program* program);
 
 int main(int argc, char** argv) {
     bool asLib = false;
     bool core = true;
+    CodeGenOptions options;
+    std::string profileOutput;
+    std::string profileInput;
+    std::string tracePath;
+    TimeReport report;
 
     if(argc < 2) {
         std::cout << "Usage: glang <source_file>" << std::endl;
@@ -24,26 +34,86 @@ int main(int argc, char** argv) {
             if(std::string(argv[i]) == "--no-core") {
                 core = false;
             }
+            if(std::string(argv[i]) == "-O") {
+                options.optimize = true;
+            }
+            if(std::string(argv[i]) == "--print-ir") {
+                options.printIR = true;
+            }
+            if(std::string(argv[i]) == "-fno-vectorize") {
+                options.vectorize = false;
+            }
+            if(std::string(argv[i]) == "-mavx2") {
+                options.avx2 = true;
+            }
+            if(std::string(argv[i]) == "-fomit-frame-pointer") {
+                options.omitFramePointer = true;
+            }
+            if(std::string(argv[i]) == "-ffunction-sections") {
+                options.functionSections = true;
+            }
+            if(std::string(argv[i]) == "--profile-generate") {
+                profileOutput = "glang.profile";
+            }
+            if(std::string(argv[i]).starts_with("--profile-generate=")) {
+                profileOutput = std::string(argv[i]).substr(std::string("--profile-generate=").size());
+            }
+            if(std::string(argv[i]).starts_with("--profile-use=")) {
+                profileInput = std::string(argv[i]).substr(std::string("--profile-use=").size());
+            }
+            if(std::string(argv[i]) == "--time-report") {
+                report.enable();
+            }
+            if(std::string(argv[i]).starts_with("--trace=")) {
+                tracePath = std::string(argv[i]).substr(std::string("--trace=").size());
+                report.enable();
+            }
         }
     }
 
     std::string fileName = argv[1];
 
-    std::ifstream srcFile(fileName);
-
-    std::string line;
     Lexer lexer;
-    unsigned int number = 1;
-    while(std::getline(srcFile, line)) {
-        lexer.passLine(line, number++);
+    {
+        TimeReport::Region region(&report, "lex", "phase");
+        std::ifstream srcFile(fileName);
+
+        std::string line;
+        unsigned int number = 1;
+        while(std::getline(srcFile, line)) {
+            lexer.passLine(line, number++);
+        }
+        srcFile.close();
     }
-    srcFile.close();
 
     Parser parser(lexer.getTokens(), fileName, core);
+    parser.setTimeReport(&report);
     
     std::string outFileName = fileName.replace(fileName.find(".glang"), 6, ".asm");
 
-    Program* program = parser.parse();
+    Program* program;
+    {
+        TimeReport::Region region(&report, "parse", "phase");
+        program = parser.parse();
+    }
+
+    // Only executables are instrumented since _start writes the profile.
+    // The counters live in the AST backend, so -O is off while profiling.
+    Profile profile;
+    if(!profileOutput.empty() && !asLib) {
+        options.profileGenerate = true;
+        options.optimize = false;
+    }
+    if(!profileInput.empty() && !profile.load(profileInput)) {
+        std::cerr << profileInput << ": can't read profile" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    // The IR path only uses the counts to move functions that never ran
+    // to the end; branch order, cold bodies and loop alignment aren't
+    // taken from the profile.
+    if(profile.isLoaded() && options.optimize) {
+        std::cerr << "warning: with -O only the function layout uses " << profileInput << std::endl;
+    }
 
     //ConstExprVisitor cVisitor;
     //program->accept(&cVisitor);
@@ -51,58 +121,142 @@ int main(int argc, char** argv) {
     //printParseTree(program);
 
     TypeChecker typeChecker;
-    CodeGenVisitor visitor;
-
-    program->accept(&typeChecker);
-    program->accept(&visitor);
-
-    auto data = visitor.getDataSegment();
-    auto text = visitor.getTextSegment();
-    auto bss = visitor.getBssSegment();
-    auto ro = visitor.getROSegment();
-    auto globals = visitor.getGlobals();
-    auto externs = program->getExterns();
-
-    std::ofstream outFile(outFileName);
-
-    outFile << "section .text" << std::endl;
-    if(!asLib) {
-        outFile << "global _start" << std::endl;
-        outFile << "_start:" << std::endl;
-        outFile << "\tmov rdi, [rsp]" << std::endl;
-        outFile << "\tlea rsi, [rsp + 8]" << std::endl;
-        outFile << "\tcall main" << std::endl;
-        outFile << "\tmov rdi, rax" << std::endl;
-        outFile << "\tmov rax, 60" << std::endl;
-        outFile << "\tsyscall" << std::endl;
-    }
+    CodeGenVisitor visitor(options);
+    visitor.setProfile(&profile);
+    visitor.setTimeReport(&report);
 
-    for(const std::string& label : globals) {
-        outFile << "global " << label << std::endl;
+    {
+        TimeReport::Region region(&report, "typecheck", "phase");
+        program->accept(&typeChecker);
     }
-    for(const std::string& label : externs) {
-        outFile << "extern " << label << std::endl;
+
+    // executables only keep the functions main can reach, callers and
+    // callees are laid out next to each other
+    std::vector<FunctionDefinition*> dropped;
+    {
+        TimeReport::Region region(&report, "layout", "phase");
+        const CallGraph callGraph(program);
+        if(!asLib && std::ranges::any_of(program->functions, [](const FunctionDefinition* def) { return def->id.name == "main"; })) {
+            const std::set<std::string> reachable = callGraph.reachableFrom("main");
+            std::ranges::copy_if(program->functions, std::back_inserter(dropped), [&](const FunctionDefinition* def) { return !reachable.contains(def->id.name); });
+            std::erase_if(program->functions, [&](const FunctionDefinition* def) { return !reachable.contains(def->id.name); });
+        }
+        program->functions = callGraph.order(program->functions);
+        if(profile.isLoaded()) {
+            // functions that never ran while profiling go last
+            std::ranges::stable_partition(program->functions, [&](const FunctionDefinition* def) {
+                return profile.count(def->id.name).value_or(1) > 0;
+            });
+        }
     }
 
-    for(auto t: text) {
-        outFile << t->genNasm() << std::endl;
+    {
+        TimeReport::Region region(&report, "codegen", "phase");
+        // dropped functions are still compiled, with the rest of the program
+        // known as externs and the output thrown away, so their errors are
+        // reported like any other
+        if(!dropped.empty()) {
+            Program unused = *program;
+            for(FunctionDefinition* def : program->functions) {
+                unused.externFunctions.insert({def->id.name, def});
+            }
+            unused.functions = dropped;
+            CodeGenOptions unusedOptions = options;
+            unusedOptions.printIR = false;
+            unusedOptions.profileGenerate = false;
+            CodeGenVisitor discard(unusedOptions);
+            unused.accept(&discard);
+        }
+        program->accept(&visitor);
     }
 
-    outFile << std::endl << "section .data" << std::endl;
+    // a scope of its own so the file is flushed and closed before the
+    // report is printed
+    {
+        TimeReport::Region region(&report, "emit", "phase");
 
-    for(auto d : data) {
-        outFile << d->genNasm() << std::endl;
-    }
+        auto data = visitor.getDataSegment();
+        auto text = visitor.getTextSegment();
+        auto bss = visitor.getBssSegment();
+        auto ro = visitor.getROSegment();
+        auto globals = visitor.getGlobals();
+        auto externs = program->getExterns();
+
+        std::ofstream outFile(outFileName);
+
+        outFile << "section .text" << std::endl;
+        if(!asLib) {
+            outFile << "global _start" << std::endl;
+            outFile << "_start:" << std::endl;
+            outFile << "\tmov rdi, [rsp]" << std::endl;
+            outFile << "\tlea rsi, [rsp + 8]" << std::endl;
+            outFile << "\tcall main" << std::endl;
+            // the exit code waits in rbx while buffered output and the
+            // profile are written out
+            outFile << "\tmov rbx, rax" << std::endl;
+            if(core) {
+                outFile << "\tcall flush_all" << std::endl;
+            }
+            if(options.profileGenerate) {
+                for(auto op : profile.emitDump()) {
+                    outFile << op->genNasm() << std::endl;
+                }
+            }
+            // exit_group, exit would only end this thread and leave the
+            // status to whichever thread of the process ends last
+            outFile << "\tmov rdi, rbx" << std::endl;
+            outFile << "\tmov rax, 231" << std::endl;
+            outFile << "\tsyscall" << std::endl;
+        }
+
+        for(const std::string& label : globals) {
+            outFile << "global " << label << std::endl;
+        }
+        for(const std::string& label : externs) {
+            outFile << "extern " << label << std::endl;
+        }
+
+        for(auto t: text) {
+            outFile << t->genNasm() << std::endl;
+        }
+
+        outFile << std::endl << "section .data" << std::endl;
 
-    outFile << std::endl << "section .bss" << std::endl;
+        for(auto d : data) {
+            outFile << d->genNasm() << std::endl;
+        }
+
+        outFile << std::endl << "section .bss" << std::endl;
+        if(options.profileGenerate) {
+            for(auto d : profile.defineCounters()) {
+                outFile << d->genNasm() << std::endl;
+            }
+        }
+
+        for(auto d : bss) {
+            outFile << d->genNasm() << std::endl;
+        }
 
-    for(auto d : bss) {
-        outFile << d->genNasm() << std::endl;
+        outFile << std::endl << "section .rodata" << std::endl;
+        for(auto d : visitor.getStringPool().define()) {
+            outFile << d->genNasm() << std::endl;
+        }
+        if(options.profileGenerate) {
+            for(auto d : profile.defineKeys(profileOutput)) {
+                outFile << d->genNasm() << std::endl;
+            }
+        }
+        for(auto d : ro) {
+            outFile << d->genNasm() << std::endl;
+        }
     }
 
-    outFile << std::endl << "section .rodata" << std::endl;
-    for(auto d : ro) {
-        outFile << d->genNasm() << std::endl;
+    if(report.isEnabled()) {
+        report.print(std::cerr);
+    }
+    if(!tracePath.empty() && !report.writeTrace(tracePath)) {
+        std::cerr << tracePath << ": can't write trace" << std::endl;
+        return EXIT_FAILURE;
     }
 
     return 0;